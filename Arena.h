@@ -0,0 +1,126 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for data that lives exactly as long as a level. Memory is taken from the system in large
+// blocks and handed out by advancing an offset; nothing is freed individually. Reset() frees everything at
+// once and keeps the blocks for the next level, so a long session stops fragmenting the heap and stops
+// taking the malloc lock per allocation. Not thread safe: fill it from the loading thread.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 1 << 20) : blockSize(blockSize) {}
+    ~Arena() { Release(); }
+
+    Arena(const Arena&) = delete;
+    Arena &operator=(const Arena&) = delete;
+
+    // Blocks come from malloc, so alignments up to alignof(std::max_align_t) hold.
+    void *Allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+        if (bytes == 0) bytes = 1;
+        if (current < blocks.size()) {
+            size_t p = (offset + align - 1) & ~(align - 1);
+            if (p + bytes <= blocks[current].size) {
+                offset = p + bytes;
+                used += bytes;
+                return blocks[current].data + p;
+            }
+        }
+        // move on to the next retained block that fits, or get a new one
+        size_t next = blocks.empty() ? 0 : current + 1;
+        while (next < blocks.size() && blocks[next].size < bytes)
+            next++;
+        if (next == blocks.size()) {
+            Block b;
+            b.size = bytes > blockSize ? bytes : blockSize;
+            b.data = (char*)std::malloc(b.size);
+            if (!b.data) throw std::bad_alloc();
+            blocks.push_back(b);
+        }
+        current = next;
+        offset = bytes;
+        used += bytes;
+        return blocks[current].data;
+    }
+
+    template <typename T>
+    T *AllocateArray(size_t n) { return (T*)Allocate(n * sizeof(T), alignof(T)); }
+
+    // Null terminated copy owned by the arena.
+    const char *Copy(const std::string &s) {
+        char *p = AllocateArray<char>(s.size() + 1);
+        std::memcpy(p, s.c_str(), s.size() + 1);
+        return p;
+    }
+
+    // Frees everything allocated so far. Nothing allocated from the arena may be used afterwards.
+    void Reset() {
+        current = 0;
+        offset = 0;
+        used = 0;
+    }
+
+    // Reset() and return the blocks to the system.
+    void Release() {
+        for (auto &b : blocks) std::free(b.data);
+        blocks.clear();
+        Reset();
+    }
+
+    size_t Used() const { return used; }
+    size_t Capacity() const {
+        size_t n = 0;
+        for (auto &b : blocks) n += b.size;
+        return n;
+    }
+
+private:
+    struct Block {
+        char *data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t current = 0;
+    size_t offset = 0;
+    size_t used = 0;
+};
+
+// Standard allocator over an Arena so containers can keep their storage in it. Deallocation is a no-op;
+// the memory comes back with the arena's Reset(). Without an arena it falls back to the heap.
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    Arena *arena;
+
+    ArenaAllocator(Arena *arena = nullptr) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n) {
+        if (arena) return arena->AllocateArray<T>(n);
+        return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T *p, size_t) {
+        if (!arena) ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+};
+
+#endif
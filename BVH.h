@@ -0,0 +1,494 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 dir;
+    float tMax = 1e30f;
+
+    Ray() {}
+    Ray(glm::vec3 origin, glm::vec3 dir, float tMax = 1e30f) : origin{origin}, dir{dir}, tMax{tMax} {}
+};
+
+// Result of a sphere vs triangle soup query. The normal points from the surface towards the sphere center.
+struct SphereContact {
+    glm::vec3 point;
+    glm::vec3 normal;
+    float depth;
+    uint32_t triangle;
+};
+
+// Traversals keep their pending nodes in a fixed stack, which holds at most one node per level plus one.
+// Builds stop splitting at BVH_MAX_DEPTH, and loaded trees deeper than that are rejected.
+const int BVH_STACK_SIZE = 64;
+const int BVH_MAX_DEPTH = 60;
+
+struct BVHTriangle {
+    glm::vec3 v0, v1, v2;
+};
+
+// 32 bytes so two nodes share a cache line. Nodes are stored depth-first: the left child of an inner node
+// always follows it directly and 'offset' holds the index of the right child. For leaves 'offset' is the
+// first triangle and 'count' the number of triangles.
+struct BVHNode {
+    glm::vec3 bmin;
+    uint32_t offset;
+    glm::vec3 bmax;
+    uint32_t count;
+
+    bool IsLeaf() const { return count > 0; }
+};
+
+class TriangleBVH {
+public:
+    std::vector<BVHNode>     nodes;
+    std::vector<BVHTriangle> tris;
+    std::vector<uint32_t>    triIndices; // triangle in the bvh -> triangle in the source mesh
+    uint64_t sourceHash = 0;
+
+    static const int MAX_LEAF_SIZE = 4;
+    static const int SAH_BINS = 12;
+    static const size_t PARALLEL_THRESHOLD = 4096;
+
+    bool Empty() const { return nodes.empty(); }
+
+    // Hash of the geometry the tree was built from, used to validate a cached tree on disk.
+    static uint64_t HashGeometry(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices) {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void *data, size_t bytes) {
+            const unsigned char *p = (const unsigned char*)data;
+            for (size_t i = 0; i < bytes; i++) { h ^= p[i]; h *= 1099511628211ull; }
+        };
+        uint64_t counts[2] = { positions.size(), indices.size() };
+        mix(counts, sizeof(counts));
+        if (!positions.empty()) mix(&positions[0], positions.size() * sizeof(glm::vec3));
+        if (!indices.empty()) mix(&indices[0], indices.size() * sizeof(unsigned int));
+        return h;
+    }
+
+    void Build(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices, JobSystem *jobs = nullptr) {
+        nodes.clear();
+        tris.clear();
+        triIndices.clear();
+        sourceHash = HashGeometry(positions, indices);
+
+        size_t triCount = indices.size() / 3;
+        if (triCount == 0) return;
+
+        std::vector<Prim> prims(triCount);
+        for (size_t i = 0; i < triCount; i++) {
+            const glm::vec3 &a = positions[indices[i * 3 + 0]];
+            const glm::vec3 &b = positions[indices[i * 3 + 1]];
+            const glm::vec3 &c = positions[indices[i * 3 + 2]];
+            prims[i].bmin = glm::min(a, glm::min(b, c));
+            prims[i].bmax = glm::max(a, glm::max(b, c));
+            prims[i].centroid = (prims[i].bmin + prims[i].bmax) * 0.5f;
+            prims[i].index = (uint32_t)i;
+        }
+
+        int parallelDepth = 0;
+        if (jobs)
+            for (size_t n = jobs->WorkerCount(); n > 1; n >>= 1) parallelDepth++;
+
+        std::unique_ptr<BuildNode> root = BuildRange(prims, 0, prims.size(), 0, jobs, parallelDepth);
+
+        nodes.reserve(root->nodeCount);
+        tris.reserve(triCount);
+        triIndices.reserve(triCount);
+        Flatten(root.get(), prims, positions, indices);
+    }
+
+    // Closest hit along the ray in [0, ray.tMax]. Returns the parametric distance and source triangle.
+    bool Raycast(const Ray &ray, float &tHit, uint32_t &triangle) const {
+        if (nodes.empty()) return false;
+        glm::vec3 invDir = 1.0f / ray.dir;
+        float closest = ray.tMax;
+        bool hit = false;
+
+        uint32_t stack[BVH_STACK_SIZE];
+        int sp = 0;
+        stack[sp++] = 0;
+        while (sp > 0) {
+            const BVHNode &node = nodes[stack[--sp]];
+            if (!SlabTest(node, ray.origin, invDir, closest)) continue;
+            if (node.IsLeaf()) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                    float t;
+                    if (IntersectTriangle(tris[i], ray.origin, ray.dir, t) && t < closest) {
+                        closest = t;
+                        triangle = triIndices[i];
+                        hit = true;
+                    }
+                }
+            }
+            else {
+                uint32_t nodeIndex = (uint32_t)(&node - &nodes[0]);
+                uint32_t left = nodeIndex + 1, right = node.offset;
+                // visit the child closest to the ray origin first
+                float dl = EntryDistance(nodes[left], ray.origin, invDir);
+                float dr = EntryDistance(nodes[right], ray.origin, invDir);
+                if (dl < dr) { stack[sp++] = right; stack[sp++] = left; }
+                else         { stack[sp++] = left;  stack[sp++] = right; }
+            }
+        }
+        if (hit) tHit = closest;
+        return hit;
+    }
+
+    // True as soon as any triangle is hit in [0, ray.tMax].
+    bool RaycastAny(const Ray &ray) const {
+        if (nodes.empty()) return false;
+        glm::vec3 invDir = 1.0f / ray.dir;
+        uint32_t stack[BVH_STACK_SIZE];
+        int sp = 0;
+        stack[sp++] = 0;
+        while (sp > 0) {
+            uint32_t nodeIndex = stack[--sp];
+            const BVHNode &node = nodes[nodeIndex];
+            if (!SlabTest(node, ray.origin, invDir, ray.tMax)) continue;
+            if (node.IsLeaf()) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                    float t;
+                    if (IntersectTriangle(tris[i], ray.origin, ray.dir, t) && t <= ray.tMax) return true;
+                }
+            }
+            else {
+                stack[sp++] = node.offset;
+                stack[sp++] = nodeIndex + 1;
+            }
+        }
+        return false;
+    }
+
+    // Deepest contact between the sphere and the triangles, if any.
+    bool IntersectSphere(const glm::vec3 &center, float radius, SphereContact &contact) const {
+        if (nodes.empty()) return false;
+        float best = radius * radius;
+        bool hit = false;
+
+        uint32_t stack[BVH_STACK_SIZE];
+        int sp = 0;
+        stack[sp++] = 0;
+        while (sp > 0) {
+            uint32_t nodeIndex = stack[--sp];
+            const BVHNode &node = nodes[nodeIndex];
+            glm::vec3 c = glm::clamp(center, node.bmin, node.bmax);
+            glm::vec3 d = c - center;
+            if (glm::dot(d, d) > best) continue;
+            if (node.IsLeaf()) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                    glm::vec3 p = ClosestPointOnTriangle(center, tris[i]);
+                    glm::vec3 diff = center - p;
+                    float dist2 = glm::dot(diff, diff);
+                    if (dist2 <= best) {
+                        best = dist2;
+                        contact.point = p;
+                        contact.triangle = triIndices[i];
+                        float dist = std::sqrt(dist2);
+                        contact.depth = radius - dist;
+                        if (dist > 1e-6f)
+                            contact.normal = diff / dist;
+                        else
+                            contact.normal = glm::normalize(glm::cross(tris[i].v1 - tris[i].v0, tris[i].v2 - tris[i].v0));
+                        hit = true;
+                    }
+                }
+            }
+            else {
+                stack[sp++] = node.offset;
+                stack[sp++] = nodeIndex + 1;
+            }
+        }
+        return hit;
+    }
+
+    // Closest point on the triangle soup within maxDistance of p.
+    bool ClosestPoint(const glm::vec3 &p, float maxDistance, glm::vec3 &closest, uint32_t &triangle) const {
+        SphereContact c;
+        if (!IntersectSphere(p, maxDistance, c)) return false;
+        closest = c.point;
+        triangle = c.triangle;
+        return true;
+    }
+
+    bool Save(const std::string &path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return false;
+        uint32_t header[4] = { FILE_MAGIC, FILE_VERSION, (uint32_t)nodes.size(), (uint32_t)tris.size() };
+        out.write((const char*)header, sizeof(header));
+        out.write((const char*)&sourceHash, sizeof(sourceHash));
+        if (!nodes.empty()) out.write((const char*)&nodes[0], nodes.size() * sizeof(BVHNode));
+        if (!tris.empty()) {
+            out.write((const char*)&tris[0], tris.size() * sizeof(BVHTriangle));
+            out.write((const char*)&triIndices[0], triIndices.size() * sizeof(uint32_t));
+        }
+        return (bool)out;
+    }
+
+    // Loads a tree saved with Save(). Fails if the file is missing, corrupt or was built from other geometry:
+    // besides the hash, the triangle count must match 'indices' and every node must be in range.
+    bool Load(const std::string &path, uint64_t expectedHash, const std::vector<unsigned int> &indices) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        uint32_t header[4];
+        uint64_t hash;
+        in.read((char*)header, sizeof(header));
+        in.read((char*)&hash, sizeof(hash));
+        if (!in || header[0] != FILE_MAGIC || header[1] != FILE_VERSION || hash != expectedHash) return false;
+        if (header[3] != indices.size() / 3) return false;
+
+        std::vector<BVHNode> n(header[2]);
+        std::vector<BVHTriangle> t(header[3]);
+        std::vector<uint32_t> ti(header[3]);
+        if (!n.empty()) in.read((char*)&n[0], n.size() * sizeof(BVHNode));
+        if (!t.empty()) {
+            in.read((char*)&t[0], t.size() * sizeof(BVHTriangle));
+            in.read((char*)&ti[0], ti.size() * sizeof(uint32_t));
+        }
+        if (!in || !Valid(n, t.size())) return false;
+        for (uint32_t i : ti)
+            if (i >= header[3]) return false;
+
+        nodes.swap(n);
+        tris.swap(t);
+        triIndices.swap(ti);
+        sourceHash = hash;
+        return true;
+    }
+
+    static bool IntersectTriangle(const BVHTriangle &tri, const glm::vec3 &origin, const glm::vec3 &dir, float &t) {
+        // Moller-Trumbore
+        glm::vec3 e1 = tri.v1 - tri.v0;
+        glm::vec3 e2 = tri.v2 - tri.v0;
+        glm::vec3 p = glm::cross(dir, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < 1e-9f) return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - tri.v0;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(dir, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+        t = glm::dot(e2, q) * invDet;
+        return t >= 0.0f;
+    }
+
+    static glm::vec3 ClosestPointOnTriangle(const glm::vec3 &p, const BVHTriangle &tri) {
+        // Ericson, Real-Time Collision Detection 5.1.5
+        const glm::vec3 &a = tri.v0, &b = tri.v1, &c = tri.v2;
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) return a;
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) return b;
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) return c;
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        float denom = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    static bool SlabTest(const BVHNode &node, const glm::vec3 &origin, const glm::vec3 &invDir, float tMax) {
+        return EntryDistance(node, origin, invDir) <= tMax;
+    }
+
+    // Distance along the ray to the node's box, or +inf when it is missed.
+    static float EntryDistance(const BVHNode &node, const glm::vec3 &origin, const glm::vec3 &invDir) {
+        glm::vec3 t0 = (node.bmin - origin) * invDir;
+        glm::vec3 t1 = (node.bmax - origin) * invDir;
+        glm::vec3 tsmall = glm::min(t0, t1);
+        glm::vec3 tbig = glm::max(t0, t1);
+        float tmin = std::max(std::max(tsmall.x, tsmall.y), std::max(tsmall.z, 0.0f));
+        float tmax = std::min(tbig.x, std::min(tbig.y, tbig.z));
+        return tmin <= tmax ? tmin : 1e30f;
+    }
+
+private:
+    static const uint32_t FILE_MAGIC = 0x31485642; // "BVH1"
+    static const uint32_t FILE_VERSION = 1;
+
+    struct Prim {
+        glm::vec3 bmin, bmax, centroid;
+        uint32_t index;
+    };
+
+    struct BuildNode {
+        glm::vec3 bmin, bmax;
+        size_t begin, end;
+        size_t nodeCount = 1;
+        std::unique_ptr<BuildNode> left, right;
+    };
+
+    static float Area(const glm::vec3 &bmin, const glm::vec3 &bmax) {
+        glm::vec3 e = bmax - bmin;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    // Depth-first layout with every child after its parent, leaves inside the triangles, no deeper than
+    // BVH_MAX_DEPTH. Anything else read from disk would index out of bounds.
+    static bool Valid(const std::vector<BVHNode> &n, size_t triCount) {
+        if (n.empty()) return triCount == 0;
+        uint32_t stack[BVH_STACK_SIZE], depth[BVH_STACK_SIZE];
+        int sp = 0;
+        stack[sp] = 0;
+        depth[sp++] = 0;
+        while (sp > 0) {
+            sp--;
+            uint32_t i = stack[sp], d = depth[sp];
+            const BVHNode &node = n[i];
+            if (node.IsLeaf()) {
+                if (node.offset > triCount || node.count > triCount - node.offset) return false;
+                continue;
+            }
+            if (d >= (uint32_t)BVH_MAX_DEPTH || i + 1 >= n.size() || node.offset <= i + 1 || node.offset >= n.size())
+                return false;
+            stack[sp] = node.offset;
+            depth[sp++] = d + 1;
+            stack[sp] = i + 1;
+            depth[sp++] = d + 1;
+        }
+        return true;
+    }
+
+    // The top 'parallelDepth' levels build their left half as a job while this thread builds the right one
+    std::unique_ptr<BuildNode> BuildRange(std::vector<Prim> &prims, size_t begin, size_t end, int depth, JobSystem *jobs,
+                                          int parallelDepth) {
+        std::unique_ptr<BuildNode> node(new BuildNode());
+        node->begin = begin;
+        node->end = end;
+        node->bmin = glm::vec3(1e30f);
+        node->bmax = glm::vec3(-1e30f);
+        glm::vec3 cmin(1e30f), cmax(-1e30f);
+        for (size_t i = begin; i < end; i++) {
+            node->bmin = glm::min(node->bmin, prims[i].bmin);
+            node->bmax = glm::max(node->bmax, prims[i].bmax);
+            cmin = glm::min(cmin, prims[i].centroid);
+            cmax = glm::max(cmax, prims[i].centroid);
+        }
+
+        size_t count = end - begin;
+        if (count <= MAX_LEAF_SIZE || depth >= BVH_MAX_DEPTH) return node;
+
+        // binned SAH over the longest useful axes
+        int bestAxis = -1, bestSplit = -1;
+        float bestCost = 1e30f;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = cmax[axis] - cmin[axis];
+            if (extent <= 0.0f) continue;
+            float scale = SAH_BINS / extent;
+
+            glm::vec3 binMin[SAH_BINS], binMax[SAH_BINS];
+            size_t binCount[SAH_BINS] = {};
+            for (int b = 0; b < SAH_BINS; b++) { binMin[b] = glm::vec3(1e30f); binMax[b] = glm::vec3(-1e30f); }
+            for (size_t i = begin; i < end; i++) {
+                int b = std::min(SAH_BINS - 1, (int)((prims[i].centroid[axis] - cmin[axis]) * scale));
+                binCount[b]++;
+                binMin[b] = glm::min(binMin[b], prims[i].bmin);
+                binMax[b] = glm::max(binMax[b], prims[i].bmax);
+            }
+
+            // sweep from the right to get the area of every suffix, then from the left to evaluate splits
+            float rightArea[SAH_BINS];
+            size_t rightCount[SAH_BINS];
+            glm::vec3 rmin(1e30f), rmax(-1e30f);
+            size_t rc = 0;
+            for (int b = SAH_BINS - 1; b > 0; b--) {
+                rc += binCount[b];
+                rmin = glm::min(rmin, binMin[b]);
+                rmax = glm::max(rmax, binMax[b]);
+                rightCount[b] = rc;
+                rightArea[b] = rc ? Area(rmin, rmax) : 0.0f;
+            }
+            glm::vec3 lmin(1e30f), lmax(-1e30f);
+            size_t lc = 0;
+            for (int b = 0; b < SAH_BINS - 1; b++) {
+                lc += binCount[b];
+                lmin = glm::min(lmin, binMin[b]);
+                lmax = glm::max(lmax, binMax[b]);
+                if (lc == 0 || rightCount[b + 1] == 0) continue;
+                float cost = lc * Area(lmin, lmax) + rightCount[b + 1] * rightArea[b + 1];
+                if (cost < bestCost) { bestCost = cost; bestAxis = axis; bestSplit = b; }
+            }
+        }
+
+        size_t mid;
+        if (bestAxis >= 0) {
+            float leafCost = count * Area(node->bmin, node->bmax);
+            if (bestCost >= leafCost && count <= 4 * MAX_LEAF_SIZE) return node;
+            float scale = SAH_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+            float lo = cmin[bestAxis];
+            auto it = std::partition(prims.begin() + begin, prims.begin() + end, [=](const Prim &p) {
+                return std::min(SAH_BINS - 1, (int)((p.centroid[bestAxis] - lo) * scale)) <= bestSplit;
+            });
+            mid = it - prims.begin();
+        }
+        else {
+            // all centroids coincide: split in the middle so leaves stay small
+            mid = begin + count / 2;
+        }
+        if (mid == begin || mid == end) mid = begin + count / 2;
+
+        if (parallelDepth > 0 && count > PARALLEL_THRESHOLD) {
+            BuildNode *parent = node.get();
+            JobHandle left = jobs->Schedule([&, parent, begin, mid, depth, parallelDepth]() {
+                parent->left = BuildRange(prims, begin, mid, depth + 1, jobs, parallelDepth - 1);
+            });
+            node->right = BuildRange(prims, mid, end, depth + 1, jobs, parallelDepth - 1);
+            jobs->Wait(left);
+        }
+        else {
+            node->left = BuildRange(prims, begin, mid, depth + 1, nullptr, 0);
+            node->right = BuildRange(prims, mid, end, depth + 1, nullptr, 0);
+        }
+        node->nodeCount = 1 + node->left->nodeCount + node->right->nodeCount;
+        return node;
+    }
+
+    void Flatten(const BuildNode *b, const std::vector<Prim> &prims,
+                 const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices) {
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.push_back(BVHNode());
+        nodes[index].bmin = b->bmin;
+        nodes[index].bmax = b->bmax;
+        if (!b->left) {
+            nodes[index].offset = (uint32_t)tris.size();
+            nodes[index].count = (uint32_t)(b->end - b->begin);
+            for (size_t i = b->begin; i < b->end; i++) {
+                uint32_t src = prims[i].index;
+                BVHTriangle t;
+                t.v0 = positions[indices[src * 3 + 0]];
+                t.v1 = positions[indices[src * 3 + 1]];
+                t.v2 = positions[indices[src * 3 + 2]];
+                tris.push_back(t);
+                triIndices.push_back(src);
+            }
+            return;
+        }
+        nodes[index].count = 0;
+        Flatten(b->left.get(), prims, positions, indices);
+        nodes[index].offset = (uint32_t)nodes.size();
+        Flatten(b->right.get(), prims, positions, indices);
+    }
+};
+
+#endif
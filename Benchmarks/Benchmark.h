@@ -0,0 +1,340 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// A small microbenchmark harness in the manner of Google Benchmark, so results can be tracked with the same
+// tools: cases loop on KeepRunning(), the harness grows the iteration count until a run takes at least
+// --benchmark_min_time, and --benchmark_out writes Google Benchmark's JSON format.
+//
+//   RegisterBenchmark("BoundingBox::Collision", [](BenchState &state) {
+//       while (state.KeepRunning()) DoNotOptimize(a.Collision(b));
+//   });
+//   return RunBenchmarks(argc, argv);
+//
+// Flags: --benchmark_filter=<regex> --benchmark_min_time=<s> --benchmark_repetitions=<n>
+//        --benchmark_out=<file.json> --benchmark_list_tests
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Keeps the compiler from optimising away a value or the stores before it
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+inline void ClobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+// CPU time of the calling thread, in seconds
+inline double ThreadCpuSeconds() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return (double)std::clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// One run of a case: a fixed number of iterations, timed between the first and the last KeepRunning
+class BenchState {
+public:
+    explicit BenchState(uint64_t iterations) : iterations(iterations), remaining(iterations) {}
+
+    bool KeepRunning() {
+        if (!started) {
+            started = true;
+            Resume();
+        }
+        if (remaining > 0 && !skipped) {
+            remaining--;
+            return true;
+        }
+        if (timing) Pause();
+        return false;
+    }
+
+    // Excludes setup or teardown inside the loop from the measurement
+    void PauseTiming() { Pause(); }
+    void ResumeTiming() { Resume(); }
+
+    void SetItemsProcessed(int64_t items) { itemsProcessed = items; }
+    void SetBytesProcessed(int64_t bytes) { bytesProcessed = bytes; }
+    void SetLabel(const std::string &text) { label = text; }
+
+    // The case cannot run, e.g. without a GL context. Its loop ends and the run is reported as an error.
+    void SkipWithError(const std::string &message) {
+        skipped = true;
+        error = message;
+    }
+
+    uint64_t Iterations() const { return iterations; }
+
+private:
+    friend class BenchmarkRunner;
+
+    uint64_t iterations, remaining;
+    bool started = false, timing = false, skipped = false;
+    double realSeconds = 0.0, cpuSeconds = 0.0;
+    std::chrono::steady_clock::time_point realStart;
+    double cpuStart = 0.0;
+    int64_t itemsProcessed = 0, bytesProcessed = 0;
+    std::string label, error;
+
+    void Resume() {
+        if (timing) return;
+        timing = true;
+        cpuStart = ThreadCpuSeconds();
+        realStart = std::chrono::steady_clock::now();
+    }
+
+    void Pause() {
+        if (!timing) return;
+        realSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - realStart).count();
+        cpuSeconds += ThreadCpuSeconds() - cpuStart;
+        timing = false;
+    }
+};
+
+struct BenchmarkCase {
+    std::string name;
+    std::function<void(BenchState&)> run;
+};
+
+// What one repetition measured, or an aggregate of the repetitions
+struct BenchmarkResult {
+    std::string name, runName, aggregate, label, error;
+    uint64_t iterations = 0;
+    int repetitionIndex = 0;
+    double realNs = 0.0, cpuNs = 0.0; // per iteration
+    double itemsPerSecond = 0.0, bytesPerSecond = 0.0;
+};
+
+class BenchmarkRunner {
+public:
+    double minTime = 0.5;  // seconds a run must last to be reported
+    int repetitions = 1;
+    std::string filter = ".*", outPath;
+    bool listOnly = false;
+
+    void Add(const std::string &name, std::function<void(BenchState&)> run) { cases.push_back({ name, run }); }
+
+    // Returns false on an unknown flag
+    bool ParseFlags(int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (Flag(arg, "--benchmark_filter=")) filter = Value(arg);
+            else if (Flag(arg, "--benchmark_min_time=")) minTime = std::atof(Value(arg).c_str());
+            else if (Flag(arg, "--benchmark_repetitions=")) repetitions = std::max(1, std::atoi(Value(arg).c_str()));
+            else if (Flag(arg, "--benchmark_out=")) outPath = Value(arg);
+            else if (arg == "--benchmark_list_tests") listOnly = true;
+            else {
+                std::cout << "ERROR::BENCHMARK::UNKNOWN_FLAG " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Runs the cases matching the filter. Returns the process exit status.
+    int Run(const std::string &executable) {
+        std::regex match(filter);
+        std::vector<BenchmarkResult> results;
+        if (!listOnly)
+            std::printf("%-48s %14s %14s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+        for (const BenchmarkCase &c : cases) {
+            if (!std::regex_search(c.name, match)) continue;
+            if (listOnly) {
+                std::printf("%s\n", c.name.c_str());
+                continue;
+            }
+            std::vector<BenchmarkResult> reps;
+            for (int r = 0; r < repetitions; r++) {
+                BenchmarkResult result = RunCase(c);
+                result.repetitionIndex = r;
+                Print(result);
+                reps.push_back(result);
+                if (!result.error.empty()) break;
+            }
+            results.insert(results.end(), reps.begin(), reps.end());
+            if (repetitions > 1 && reps.back().error.empty())
+                for (const char *aggregate : { "mean", "median", "stddev" }) {
+                    BenchmarkResult a = Aggregate(reps, aggregate);
+                    Print(a);
+                    results.push_back(a);
+                }
+        }
+        // Skipped cases are reported, not failed: they depend on the machine, e.g. having a GL context
+        if (!outPath.empty() && !WriteJson(outPath, executable, results)) return 1;
+        return 0;
+    }
+
+private:
+    std::vector<BenchmarkCase> cases;
+
+    static bool Flag(const std::string &arg, const char *prefix) { return arg.compare(0, std::strlen(prefix), prefix) == 0; }
+    static std::string Value(const std::string &arg) { return arg.substr(arg.find('=') + 1); }
+
+    // Grows the iteration count like Google Benchmark: aim 40% past the minimum time, at most 10x per try
+    BenchmarkResult RunCase(const BenchmarkCase &c) const {
+        uint64_t iterations = 1;
+        for (;;) {
+            BenchState state(iterations);
+            c.run(state);
+            double seconds = std::max(state.realSeconds, state.cpuSeconds);
+            if (state.skipped || seconds >= minTime || iterations >= 1000000000ull)
+                return Result(c.name, state);
+            double multiplier = seconds > 1e-9 ? minTime * 1.4 / seconds : 10.0;
+            multiplier = std::min(10.0, std::max(multiplier, 1.0));
+            iterations = std::max(iterations + 1, (uint64_t)(iterations * multiplier));
+        }
+    }
+
+    static BenchmarkResult Result(const std::string &name, const BenchState &state) {
+        BenchmarkResult r;
+        r.name = r.runName = name;
+        r.iterations = state.iterations;
+        r.label = state.label;
+        r.error = state.error;
+        if (state.skipped) return r;
+        r.realNs = state.realSeconds * 1e9 / state.iterations;
+        r.cpuNs = state.cpuSeconds * 1e9 / state.iterations;
+        if (state.realSeconds > 0.0) {
+            r.itemsPerSecond = state.itemsProcessed / state.realSeconds;
+            r.bytesPerSecond = state.bytesProcessed / state.realSeconds;
+        }
+        return r;
+    }
+
+    static BenchmarkResult Aggregate(const std::vector<BenchmarkResult> &reps, const std::string &aggregate) {
+        auto reduce = [&](double BenchmarkResult::*field) {
+            std::vector<double> v;
+            for (const BenchmarkResult &r : reps) v.push_back(r.*field);
+            double mean = 0.0;
+            for (double x : v) mean += x;
+            mean /= v.size();
+            if (aggregate == "mean") return mean;
+            if (aggregate == "median") {
+                std::sort(v.begin(), v.end());
+                return v.size() % 2 ? v[v.size() / 2] : 0.5 * (v[v.size() / 2 - 1] + v[v.size() / 2]);
+            }
+            double sq = 0.0;
+            for (double x : v) sq += (x - mean) * (x - mean);
+            return v.size() > 1 ? std::sqrt(sq / (v.size() - 1)) : 0.0;
+        };
+        BenchmarkResult a;
+        a.runName = reps[0].runName;
+        a.name = a.runName + "_" + aggregate;
+        a.aggregate = aggregate;
+        a.iterations = reps.size();
+        a.label = reps[0].label;
+        a.realNs = reduce(&BenchmarkResult::realNs);
+        a.cpuNs = reduce(&BenchmarkResult::cpuNs);
+        a.itemsPerSecond = reduce(&BenchmarkResult::itemsPerSecond);
+        a.bytesPerSecond = reduce(&BenchmarkResult::bytesPerSecond);
+        return a;
+    }
+
+    static void Print(const BenchmarkResult &r) {
+        if (!r.error.empty()) {
+            std::printf("%-48s ERROR: %s\n", r.name.c_str(), r.error.c_str());
+            return;
+        }
+        std::printf("%-48s %11.0f ns %11.0f ns %12llu", r.name.c_str(), r.realNs, r.cpuNs, (unsigned long long)r.iterations);
+        if (r.itemsPerSecond > 0.0) std::printf(" items_per_second=%.4g/s", r.itemsPerSecond);
+        if (r.bytesPerSecond > 0.0) std::printf(" bytes_per_second=%.4gM/s", r.bytesPerSecond / (1 << 20));
+        if (!r.label.empty()) std::printf(" %s", r.label.c_str());
+        std::printf("\n");
+    }
+
+    static std::string Escape(const std::string &s) {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    static bool WriteJson(const std::string &path, const std::string &executable, const std::vector<BenchmarkResult> &results) {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "ERROR::BENCHMARK::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        char date[64];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+        char host[256] = "unknown";
+#if defined(__unix__) || defined(__APPLE__)
+        gethostname(host, sizeof(host));
+#endif
+        file.precision(10);
+        file << "{\n  \"context\": {\n"
+             << "    \"date\": \"" << date << "\",\n"
+             << "    \"host_name\": \"" << Escape(host) << "\",\n"
+             << "    \"executable\": \"" << Escape(executable) << "\",\n"
+             << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#if defined(NDEBUG)
+             << "    \"library_build_type\": \"release\"\n"
+#else
+             << "    \"library_build_type\": \"debug\"\n"
+#endif
+             << "  },\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult &r = results[i];
+            file << (i ? ",\n" : "\n") << "    {\"name\": \"" << Escape(r.name) << "\", \"run_name\": \"" << Escape(r.runName) << "\", ";
+            if (r.aggregate.empty())
+                file << "\"run_type\": \"iteration\", \"repetition_index\": " << r.repetitionIndex << ", ";
+            else
+                file << "\"run_type\": \"aggregate\", \"aggregate_name\": \"" << r.aggregate << "\", ";
+            if (!r.error.empty())
+                file << "\"error_occurred\": true, \"error_message\": \"" << Escape(r.error) << "\", ";
+            file << "\"iterations\": " << r.iterations << ", \"real_time\": " << r.realNs << ", \"cpu_time\": " << r.cpuNs
+                 << ", \"time_unit\": \"ns\"";
+            if (r.itemsPerSecond > 0.0) file << ", \"items_per_second\": " << r.itemsPerSecond;
+            if (r.bytesPerSecond > 0.0) file << ", \"bytes_per_second\": " << r.bytesPerSecond;
+            if (!r.label.empty()) file << ", \"label\": \"" << Escape(r.label) << "\"";
+            file << "}";
+        }
+        file << "\n  ]\n}\n";
+        std::cout << "Results written to " << path << std::endl;
+        return (bool)file;
+    }
+};
+
+BenchmarkRunner benchmarkRunner;
+
+inline void RegisterBenchmark(const std::string &name, std::function<void(BenchState&)> run) { benchmarkRunner.Add(name, run); }
+
+inline int RunBenchmarks(int argc, char **argv) {
+    if (!benchmarkRunner.ParseFlags(argc, argv)) return 1;
+    return benchmarkRunner.Run(argv[0]);
+}
+
+#endif
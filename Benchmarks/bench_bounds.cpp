@@ -0,0 +1,65 @@
+// Batch AABB overlap: boxes reached through one pointer each against the SoA BoundsStore kernels.
+// Build from the repository root, e.g.
+//   g++ -O2 -mavx2 -I. Benchmarks/bench_bounds.cpp stb_image.cpp -lglfw -lGL -lassimp -o bench_bounds
+#include <glad/glad.h>
+
+#include "../Objects.h"
+#include "../BoundsStore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename F>
+double TimePerQuery(int queries, F f) {
+    auto start = Clock::now();
+    for (int q = 0; q < queries; q++) f(q);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queries;
+}
+
+int main() {
+    const size_t sizes[] = { 1000, 10000, 100000, 1000000 };
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+
+    std::printf("%10s %14s %14s %14s %14s\n", "boxes", "pointer ns/q", "scalar ns/q", "sse ns/q", "avx ns/q");
+    for (size_t n : sizes) {
+        // boxes allocated one by one, as per-object bounds would be, so they are scattered in memory
+        std::vector<std::unique_ptr<BoundingBox>> boxes;
+        std::vector<BoundingBox*> vBox;
+        BoundsStore store;
+        for (size_t i = 0; i < n; i++) {
+            glm::vec3 c(coord(rng), coord(rng), coord(rng));
+            boxes.emplace_back(new BoundingBox());
+            boxes.back()->Calculate(c, RAD_FOR_BOUNDS);
+            vBox.push_back(boxes.back().get());
+            store.Add(*boxes.back());
+        }
+
+        const int queries = (int)std::max<size_t>(10, 20000000 / n);
+        std::vector<BoundingBox> q(queries);
+        for (auto &b : q) { glm::vec3 c(coord(rng), coord(rng), coord(rng)); b.Calculate(c, 5.0f); }
+        std::vector<uint8_t> masks(store.Blocks());
+
+        size_t hitsObj = 0, hitsScalar = 0, hitsSSE = 0, hitsAVX = 0;
+        double tObj = TimePerQuery(queries, [&](int k) {
+            for (auto box : vBox) hitsObj += q[k].Collision(*box);
+        });
+        auto countHits = [&]() { size_t h = 0; for (uint8_t m : masks) h += __builtin_popcount(m); return h; };
+        double tScalar = TimePerQuery(queries, [&](int k) { store.OverlapScalar(q[k], &masks[0]); hitsScalar += countHits(); });
+        double tSSE = -1.0, tAVX = -1.0;
+#if defined(BOUNDS_SSE)
+        tSSE = TimePerQuery(queries, [&](int k) { store.OverlapSSE(q[k], &masks[0]); hitsSSE += countHits(); });
+#endif
+#if defined(BOUNDS_AVX)
+        tAVX = TimePerQuery(queries, [&](int k) { store.OverlapAVX(q[k], &masks[0]); hitsAVX += countHits(); });
+#endif
+        std::printf("%10zu %14.1f %14.1f %14.1f %14.1f\n", n, tObj, tScalar, tSSE, tAVX);
+        if (hitsScalar != hitsObj || (tSSE >= 0 && hitsSSE != hitsObj) || (tAVX >= 0 && hitsAVX != hitsObj))
+            std::printf("ERROR: kernels disagree (%zu %zu %zu %zu)\n", hitsObj, hitsScalar, hitsSSE, hitsAVX);
+    }
+    return 0;
+}
@@ -0,0 +1,293 @@
+// Microbenchmarks of the engine's hot kernels: mesh generation and import, bounds, camera, the entity store's
+// systems and texture decode. Run from the repository root, which has the Models directory;
+// --benchmark_out=<file.json> saves the results in Google Benchmark's format for tracking over time. Build e.g.
+//   g++ -O2 -std=c++17 -mavx2 -mfma -pthread -I. Benchmarks/bench_kernels.cpp stb_image.cpp -lglfw -lGL -lassimp -o bench_kernels
+// or without a display, with -DHEADLESS_EGL ... -lEGL instead of -lglfw.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "../Objects.h"
+#include "../Camera.h"
+#include "../EntityStore.h"
+#include "../Headless.h"
+#include "Benchmark.h"
+
+#include <filesystem>
+#include <random>
+
+// Cases that create meshes need a current context; they are skipped without one
+bool glReady = false;
+
+bool CreateContext() {
+#if defined(HEADLESS_EGL) || defined(HEADLESS_OSMESA)
+    static HeadlessContext context;
+    if (!context.Create(64, 64)) return false;
+    return gladLoadGLLoader((GLADloadproc)HeadlessContext::ProcAddress);
+#else
+    if (!glfwInit()) return false;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "bench_kernels", NULL, NULL);
+    if (!window) return false;
+    glfwMakeContextCurrent(window);
+    return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+#endif
+}
+
+// Frees a vertex array with the vertex and index buffers Setup attached to it, which it does not keep
+void DeleteVertexArray(GLuint vertexArray) {
+    GLint buffers[2] = { 0, 0 };
+    glBindVertexArray(vertexArray);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffers[0]);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffers[1]);
+    glBindVertexArray(0);
+    GLuint ids[2] = { (GLuint)buffers[0], (GLuint)buffers[1] };
+    glDeleteBuffers(2, ids);
+    glDeleteVertexArrays(1, &vertexArray);
+}
+
+const char *const MODELS[] = { "./Models/Ball/ball.obj", "./Models/Box/box.obj", "./Models/Floor/floor.obj", "./Models/Wall/wall.obj" };
+
+std::string FileName(const std::string &path) { return path.substr(path.find_last_of('/') + 1); }
+
+void RegisterSphereSetup() {
+    for (int n : { 8, 16, 32, 64, 128 })
+        RegisterBenchmark("Sphere::Setup/" + std::to_string(n) + "x" + std::to_string(n), [n](BenchState &state) {
+            if (!glReady) return state.SkipWithError("no GL context");
+            while (state.KeepRunning()) {
+                Sphere sphere(1.0f, n, n);
+                sphere.Setup();
+                state.PauseTiming();
+                DeleteVertexArray(sphere.vao.ID);
+                state.ResumeTiming();
+            }
+            state.SetItemsProcessed(state.Iterations() * (n + 1) * (n + 1));
+        });
+}
+
+// One import's meshes through processMesh, textures already cached as they are after a model's first mesh
+void RegisterProcessMesh() {
+    for (const char *path : MODELS)
+        RegisterBenchmark("Model::processMesh/" + FileName(path), [path](BenchState &state) {
+            if (!glReady) return state.SkipWithError("no GL context");
+            Assimp::Importer importer;
+            const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+            if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+                return state.SkipWithError(importer.GetErrorString());
+            Model model(path);
+            model.dir = std::string(path).substr(0, std::string(path).find_last_of('/'));
+            int64_t vertices = 0;
+            for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+                DeleteVertexArray(model.processMesh(scene->mMeshes[i], scene).vao.ID);
+                vertices += scene->mMeshes[i]->mNumVertices;
+            }
+            while (state.KeepRunning())
+                for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+                    Mesh mesh = model.processMesh(scene->mMeshes[i], scene);
+                    state.PauseTiming();
+                    DeleteVertexArray(mesh.vao.ID);
+                    state.ResumeTiming();
+                }
+            state.SetItemsProcessed(state.Iterations() * vertices);
+            state.SetLabel(std::to_string(vertices) + " vertices");
+        });
+}
+
+void RegisterBoundingBox() {
+    const size_t N = 1024;
+    RegisterBenchmark("BoundingBox::Collision", [N](BenchState &state) {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> coord(-20.0f, 20.0f);
+        std::vector<BoundingBox> boxes(N);
+        for (auto &b : boxes) { glm::vec3 c(coord(rng), coord(rng), coord(rng)); b.Calculate(c, 2.0f); }
+        size_t hits = 0;
+        while (state.KeepRunning())
+            for (size_t i = 0; i < N; i++) hits += boxes[i].Collision(boxes[(i * 7 + 1) % N]);
+        DoNotOptimize(hits);
+        state.SetItemsProcessed(state.Iterations() * N);
+    });
+    RegisterBenchmark("BoundingBox::Calculate/sphere", [N](BenchState &state) {
+        std::vector<glm::vec3> centers(N);
+        for (size_t i = 0; i < N; i++) centers[i] = glm::vec3((float)i, 0.5f * i, -0.25f * i);
+        BoundingBox box;
+        while (state.KeepRunning())
+            for (size_t i = 0; i < N; i++) {
+                box.Calculate(centers[i], RAD_FOR_BOUNDS);
+                DoNotOptimize(box);
+            }
+        state.SetItemsProcessed(state.Iterations() * N);
+    });
+    RegisterBenchmark("BoundingBox::Calculate/matrix", [N](BenchState &state) {
+        std::vector<glm::mat4> models(N);
+        for (size_t i = 0; i < N; i++)
+            models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3((float)i, 0.0f, 0.0f)), glm::radians((float)i), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::vec3 lmin(-1.0f), lmax(1.0f);
+        BoundingBox box;
+        while (state.KeepRunning())
+            for (size_t i = 0; i < N; i++) {
+                box.Calculate(models[i], lmin, lmax);
+                DoNotOptimize(box);
+            }
+        state.SetItemsProcessed(state.Iterations() * N);
+    });
+}
+
+void RegisterCamera() {
+    RegisterBenchmark("Camera::GetViewMatrix", [](BenchState &state) {
+        Camera camera(glm::vec3(0.0f, 0.0f, 20.0f));
+        while (state.KeepRunning()) {
+            glm::mat4 view = camera.GetViewMatrix();
+            DoNotOptimize(view);
+            camera.Position.x += 0.001f;
+        }
+    });
+    // updateCameraVectors is private; mouse look is the per-frame path that calls it
+    RegisterBenchmark("Camera::ProcessMouseMovement", [](BenchState &state) {
+        Camera camera(glm::vec3(0.0f, 0.0f, 20.0f));
+        float direction = 1.0f;
+        while (state.KeepRunning()) {
+            camera.ProcessMouseMovement(0.5f * direction, 0.25f * direction);
+            direction = -direction;
+            DoNotOptimize(camera.Front);
+        }
+    });
+    RegisterBenchmark("Camera::SetPose", [](BenchState &state) {
+        Camera camera;
+        float yaw = 0.0f;
+        while (state.KeepRunning()) {
+            camera.SetPose(glm::vec3(0.0f, 1.0f, 2.0f), yaw, 10.0f);
+            yaw += 0.1f;
+            DoNotOptimize(camera.Front);
+        }
+    });
+}
+
+// A store like a stress scene: half idle crates, a quarter projectiles in flight, the rest static. Entities
+// have no asset, so they are given unit local bounds and made visible by hand.
+void FillStore(EntityStore &store, size_t n) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-20.0f, 20.0f), speed(-8.0f, 8.0f);
+    store.Reserve(n);
+    store.ReserveProjectiles(n / 4);
+    for (size_t i = 0; i < n; i++) {
+        glm::vec3 pos(coord(rng), coord(rng), coord(rng));
+        EntityKind kind = i % 4 == 0 ? KIND_PROJECTILE : (i % 2 == 1 ? KIND_CRATE : KIND_STATIC);
+        Entity e = store.Create("bench", kind, nullptr, pos, 0.0f, glm::vec3(0.6f));
+        uint32_t r = store.Row(e);
+        store.bounds.lminX[r] = store.bounds.lminY[r] = store.bounds.lminZ[r] = -1.0f;
+        store.bounds.lmaxX[r] = store.bounds.lmaxY[r] = store.bounds.lmaxZ[r] = 1.0f;
+        store.render.visible[r] = 1;
+        if (kind == KIND_CRATE) store.AddIdle(e);
+        if (kind == KIND_PROJECTILE) {
+            store.SetSphereBounds(e, RAD_FOR_BOUNDS);
+            store.AddProjectile(e);
+            store.Launch(e, pos, glm::vec3(speed(rng), speed(rng), -20.0f), 0.0f);
+        }
+    }
+    store.UpdateBounds();
+}
+
+// The per-step and per-frame systems of the entity store, single threaded over the whole store
+void RegisterStoreKernels() {
+    const float dt = 1.0f / 60.0f;
+    for (size_t n : { 1024, 16384 }) {
+        std::string size = "/" + std::to_string(n);
+        RegisterBenchmark("EntityStore::UpdateIdle" + size, [n, dt](BenchState &state) {
+            Arena arena(8 << 20);
+            EntityStore store(arena);
+            FillStore(store, n);
+            while (state.KeepRunning()) {
+                store.UpdateIdle(dt);
+                ClobberMemory();
+            }
+            state.SetItemsProcessed(state.Iterations() * store.idle.row.size());
+        });
+        RegisterBenchmark("EntityStore::IntegrateProjectiles" + size, [n, dt](BenchState &state) {
+            Arena arena(8 << 20);
+            EntityStore store(arena);
+            FillStore(store, n);
+            size_t count = store.projectiles.row.size();
+            float t = 0.0f;
+            while (state.KeepRunning()) {
+                store.IntegrateProjectiles(0, count, t += dt, dt);
+                ClobberMemory();
+            }
+            state.SetItemsProcessed(state.Iterations() * count);
+        });
+        RegisterBenchmark("EntityStore::UpdateBounds" + size, [n](BenchState &state) {
+            Arena arena(8 << 20);
+            EntityStore store(arena);
+            FillStore(store, n);
+            while (state.KeepRunning()) {
+                store.UpdateBounds();
+                ClobberMemory();
+            }
+            state.SetItemsProcessed(state.Iterations() * n);
+        });
+        // Every entity dirty, as after a step that moved them all; re-marking them is part of the time
+        RegisterBenchmark("EntityStore::UpdateRenderTransforms" + size, [n](BenchState &state) {
+            Arena arena(8 << 20);
+            EntityStore store(arena);
+            FillStore(store, n);
+            store.StorePrevious();
+            store.UpdateIdle(1.0f / 60.0f);
+            while (state.KeepRunning()) {
+                std::fill(store.transform.dirty.begin(), store.transform.dirty.end(), (uint8_t)1);
+                store.UpdateRenderTransforms(0.5f);
+                ClobberMemory();
+            }
+            state.SetItemsProcessed(state.Iterations() * n);
+        });
+        RegisterBenchmark("EntityStore::Cull" + size, [n](BenchState &state) {
+            Arena arena(8 << 20);
+            EntityStore store(arena);
+            FillStore(store, n);
+            Camera camera(glm::vec3(0.0f, 0.0f, 30.0f));
+            glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) * camera.GetViewMatrix();
+            size_t culled = 0;
+            while (state.KeepRunning())
+                culled = store.Cull(viewProjection);
+            DoNotOptimize(culled);
+            state.SetItemsProcessed(state.Iterations() * n);
+            state.SetLabel(std::to_string(culled) + " culled");
+        });
+    }
+}
+
+void RegisterTextureDecode() {
+    std::error_code error;
+    std::vector<std::string> textures;
+    for (auto &entry : std::filesystem::recursive_directory_iterator("./Models", error)) {
+        std::string ext = entry.path().extension().string();
+        if (ext == ".png" || ext == ".jpg") textures.push_back(entry.path().generic_string());
+    }
+    if (textures.empty()) std::cout << "ERROR::BENCHMARK::NO_TEXTURES run from the repository root" << std::endl;
+    std::sort(textures.begin(), textures.end());
+    for (const std::string &path : textures)
+        RegisterBenchmark("stbi_load/" + path.substr(path.find("Models/") + 7), [path](BenchState &state) {
+            int width = 0, height = 0, components = 0;
+            while (state.KeepRunning()) {
+                unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 0);
+                if (!data) return state.SkipWithError(stbi_failure_reason());
+                stbi_image_free(data);
+            }
+            state.SetBytesProcessed(state.Iterations() * width * height * components);
+            state.SetLabel(std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(components));
+        });
+}
+
+int main(int argc, char **argv) {
+    glReady = CreateContext();
+    if (!glReady) std::cout << "ERROR::BENCHMARK::NO_CONTEXT mesh cases are skipped" << std::endl;
+    stbi_set_flip_vertically_on_load(true);
+
+    RegisterSphereSetup();
+    RegisterProcessMesh();
+    RegisterBoundingBox();
+    RegisterCamera();
+    RegisterStoreKernels();
+    RegisterTextureDecode();
+    return RunBenchmarks(argc, argv);
+}
@@ -0,0 +1,66 @@
+// Mass projectile integration: scalar vs AVX2 kernels on one thread, and IntegrateProjectiles split over the
+// job system as the simulation step runs it.
+// Build from the repository root, e.g.
+//   g++ -O2 -mavx2 -mfma -pthread -I. Benchmarks/bench_projectiles.cpp stb_image.cpp -lglfw -lGL -lassimp -o bench_projectiles
+#include <glad/glad.h>
+
+#include "../EntityStore.h"
+#include "../JobSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+typedef std::chrono::steady_clock Clock;
+
+// Projectiles integrated per millisecond over 'steps' simulation steps
+template <typename F>
+double ProjectilesPerMs(size_t n, int steps, F f) {
+    auto start = Clock::now();
+    for (int s = 0; s < steps; s++) f(s);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return n * (double)steps / ms;
+}
+
+int main() {
+    const size_t sizes[] = { 1000, 10000, 50000, 200000, 1000000 };
+    const float dt = 1.0f / 60.0f;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> spread(-8.0f, 8.0f);
+
+    JobSystem jobs;
+    const size_t grain = 4096; // JOB_GRAIN in main.cpp
+    std::printf("%10s %16s %16s %16s %16s\n", "balls", "scalar proj/ms", "avx2 proj/ms", "threaded proj/ms", "+bounds proj/ms");
+    for (size_t n : sizes) {
+        Arena arena(16 << 20);
+        EntityStore store(arena);
+        store.Reserve(n);
+        store.ReserveProjectiles(n);
+        for (size_t i = 0; i < n; i++) {
+            Entity e = store.Create("ball", KIND_PROJECTILE, nullptr, glm::vec3(0.0f), 0.0f, glm::vec3(0.1f));
+            store.SetSphereBounds(e, 1.0f);
+            store.AddProjectile(e);
+            store.Launch(e, glm::vec3(0.0f, -5.0f, 15.0f), glm::vec3(spread(rng), spread(rng), -50.0f), 0.0f);
+        }
+
+        const int steps = (int)std::max<size_t>(5, 20000000 / n);
+        double scalar = ProjectilesPerMs(n, steps, [&](int s) { store.IntegrateProjectilesScalar(0, n, s * dt, dt); });
+        float check = store.transform.y[n - 1];
+        double avx2 = -1.0;
+#if defined(ENTITY_AVX2)
+        avx2 = ProjectilesPerMs(n, steps, [&](int s) { store.IntegrateProjectilesAVX2(0, n, s * dt, dt); });
+        if (std::fabs(store.transform.y[n - 1] - check) > 1e-3f * std::fabs(check) + 1e-3f)
+            std::printf("ERROR: kernels disagree (%f %f)\n", check, store.transform.y[n - 1]);
+#endif
+        auto integrate = [&](int s) {
+            jobs.Wait(jobs.ParallelFor(n, grain, [&](size_t begin, size_t end) { store.IntegrateProjectiles(begin, end, s * dt, dt); }));
+        };
+        double threaded = ProjectilesPerMs(n, steps, integrate);
+        double withBounds = ProjectilesPerMs(n, steps, [&](int s) {
+            integrate(s);
+            jobs.Wait(jobs.ParallelFor(store.Size(), grain, [&](size_t begin, size_t end) { store.UpdateBounds(begin, end); }));
+        });
+        std::printf("%10zu %16.0f %16.0f %16.0f %16.0f\n", n, scalar, avx2, threaded, withBounds);
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Scene ray queries: one ray at a time through Closest against eight at once through ClosestPacket, over a
+// SceneQuery of random boxes. Every packet lane is checked against Closest for the same ray, and Any / All
+// against Closest, so the SIMD slab test is cross-checked like the overlap kernels in bench_bounds.
+// Build from the repository root, e.g.
+//   g++ -O2 -mavx2 -pthread -I. Benchmarks/bench_raycast.cpp -o bench_raycast
+#include "../Raycast.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename F>
+double RaysPerMs(size_t rays, F f) {
+    auto start = Clock::now();
+    f();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return rays / ms;
+}
+
+// Slab test against the item's box, the narrowphase of every entity without a triangle BVH
+bool BoxRay(const BoundingBox &b, const Ray &ray, float &t, glm::vec3 &normal) {
+    glm::vec3 t0 = (b.min - ray.origin) / ray.dir;
+    glm::vec3 t1 = (b.max - ray.origin) / ray.dir;
+    glm::vec3 tsmall = glm::min(t0, t1), tbig = glm::max(t0, t1);
+    int axis = tsmall.x > tsmall.y ? (tsmall.x > tsmall.z ? 0 : 2) : (tsmall.y > tsmall.z ? 1 : 2);
+    float tmin = std::max(tsmall[axis], 0.0f);
+    float tmax = std::min(tbig.x, std::min(tbig.y, tbig.z));
+    if (tmin > tmax || tmin > ray.tMax) return false;
+    t = tmin;
+    normal = glm::vec3(0.0f);
+    normal[axis] = ray.dir[axis] > 0.0f ? -1.0f : 1.0f;
+    return true;
+}
+
+bool SameHit(const RayHit &a, const RayHit &b) {
+    if (a.Hit() != b.Hit()) return false;
+    if (!a.Hit()) return true;
+    // boxes entered at the same distance may come back in either order
+    return std::fabs(a.t - b.t) <= 1e-4f * std::max(1.0f, a.t) && (a.id == b.id || a.t == b.t);
+}
+
+int main() {
+    const size_t sizes[] = { 1000, 10000, 100000 };
+    const size_t PACKETS = 20000;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> extent(0.5f, 2.0f), unit(-1.0f, 1.0f), jitter(-0.02f, 0.02f);
+
+    std::printf("%10s %16s %16s %10s\n", "boxes", "closest rays/ms", "packet rays/ms", "hit rate");
+    for (size_t n : sizes) {
+        // the scene grows with the box count so a ray crosses about the same number of boxes at every size
+        float half = 4.0f * std::cbrt((float)n);
+        std::uniform_real_distribution<float> coord(-half, half);
+        std::vector<SceneQuery::Item> items(n);
+        for (size_t i = 0; i < n; i++) {
+            glm::vec3 c(coord(rng), coord(rng), coord(rng));
+            glm::vec3 e(extent(rng), extent(rng), extent(rng));
+            items[i].id = (uint32_t)i;
+            items[i].box.min = c - e;
+            items[i].box.max = c + e;
+        }
+        SceneQuery query;
+        // Build reorders its own copy of the items, so the narrowphase looks boxes up in the original order
+        query.Build(items, [&items](uint32_t id, const Ray &ray, float &t, glm::vec3 &normal) {
+            return BoxRay(items[id].box, ray, t, normal);
+        });
+
+        // Coherent packets: eight rays from one eye around one direction, as a small patch of screen would
+        // cast. Every seventh packet is partial, so the lanes past 'count' are exercised too.
+        std::vector<RayPacket> packets(PACKETS);
+        size_t rays = 0;
+        for (size_t k = 0; k < PACKETS; k++) {
+            glm::vec3 eye(coord(rng), coord(rng), coord(rng));
+            glm::vec3 dir = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(1e-3f));
+            int count = k % 7 == 0 ? 5 : RayPacket::SIZE;
+            for (int lane = 0; lane < count; lane++)
+                packets[k].Set(lane, Ray(eye, glm::normalize(dir + glm::vec3(jitter(rng), jitter(rng), jitter(rng))), 4.0f * half));
+            rays += count;
+        }
+
+        std::vector<RayHit> single(PACKETS * RayPacket::SIZE), packed(PACKETS * RayPacket::SIZE);
+        double tSingle = RaysPerMs(rays, [&]() {
+            for (size_t k = 0; k < PACKETS; k++)
+                for (int lane = 0; lane < packets[k].count; lane++)
+                    query.Closest(packets[k].Get(lane), single[k * RayPacket::SIZE + lane]);
+        });
+        double tPacket = RaysPerMs(rays, [&]() {
+            for (size_t k = 0; k < PACKETS; k++)
+                query.ClosestPacket(packets[k], &packed[k * RayPacket::SIZE]);
+        });
+
+        size_t hits = 0, mismatches = 0;
+        for (size_t k = 0; k < PACKETS; k++)
+            for (int lane = 0; lane < packets[k].count; lane++) {
+                const RayHit &s = single[k * RayPacket::SIZE + lane];
+                Ray ray = packets[k].Get(lane);
+                std::vector<RayHit> all = query.All(ray);
+                bool agree = SameHit(s, packed[k * RayPacket::SIZE + lane]) && query.Any(ray) == s.Hit() &&
+                             all.empty() == !s.Hit() && (all.empty() || SameHit(s, all.front()));
+                mismatches += !agree;
+                hits += s.Hit();
+            }
+        std::printf("%10zu %16.0f %16.0f %9.1f%%\n", n, tSingle, tPacket, 100.0 * hits / rays);
+        if (mismatches)
+            std::printf("ERROR: ClosestPacket, Any or All disagree with Closest on %zu of %zu rays\n", mismatches, rays);
+    }
+    return 0;
+}
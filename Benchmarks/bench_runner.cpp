@@ -0,0 +1,407 @@
+// Benchmark runner: repeats a run of the game and compares it against a stored baseline. Each run is the
+// engine's own scene through the replay harness (--replay or --flythrough, usually --headless 0); the game
+// writes its numbers with --metrics, which the runner appends to the command.
+//
+//   bench_runner [options] -- ./game --headless 0 --flythrough Benchmarks/arena_flythrough.txt
+//     --warmup <n>                   runs thrown away first, for file caches and clocks (default 1)
+//     --repetitions <n>              measured runs (default 7)
+//     --cpus <list>                  pin the game to these CPUs, e.g. 2-5 or 0,2 (Linux)
+//     --out <file>                   save the samples; a saved result is the next baseline
+//     --baseline <file>              compare against a saved result
+//     --threshold <metric>=<percent> allowed change per metric, see METRICS
+//
+// Per metric, runs further than 3 scaled MADs from the median are dropped as outliers. The change against the
+// baseline is the ratio of medians, with a 95% bootstrap confidence interval; a metric regresses when the
+// whole interval lies above its threshold, so noise alone does not fail a run. Exits 1 on a regression.
+//
+// Build: g++ -O2 -std=c++17 Benchmarks/bench_runner.cpp -o bench_runner
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Higher is worse for all of them
+struct MetricSpec {
+    const char *name;
+    double threshold; // percent
+};
+
+MetricSpec METRICS[] = {
+    { "frame_ms", 5.0 },      // median frame time
+    { "frame_ms_p99", 10.0 },
+    { "load_ms", 10.0 },      // start to first frame
+    { "memory_mb", 5.0 },     // peak resident
+    { "draw_calls", 0.0 },    // per frame; deterministic, any increase counts
+};
+const int METRIC_COUNT = sizeof(METRICS) / sizeof(METRICS[0]);
+
+// ---- Minimal JSON: enough for the game's metrics and the runner's own results ----
+
+struct Json {
+    enum Type { NONE, NUMBER, STRING, BOOLEAN, ARRAY, OBJECT } type = NONE;
+    double number = 0.0;
+    std::string text;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> members;
+
+    const Json *Get(const std::string &key) const {
+        for (auto &m : members)
+            if (m.first == key) return &m.second;
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string &text) : p(text.c_str()) {}
+
+    bool Parse(Json &out) {
+        Value(out);
+        Skip();
+        return ok && *p == '\0';
+    }
+
+private:
+    const char *p;
+    bool ok = true;
+
+    void Skip() { while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') p++; }
+
+    bool Expect(char c) {
+        Skip();
+        if (*p != c) return ok = false;
+        p++;
+        return true;
+    }
+
+    void String(std::string &out) {
+        if (!Expect('"')) return;
+        while (*p && *p != '"') {
+            if (*p == '\\' && p[1]) p++;
+            out += *p++;
+        }
+        Expect('"');
+    }
+
+    void Value(Json &out) {
+        Skip();
+        if (*p == '{') {
+            p++;
+            out.type = Json::OBJECT;
+            Skip();
+            if (*p == '}') { p++; return; }
+            do {
+                std::pair<std::string, Json> m;
+                String(m.first);
+                if (!Expect(':')) return;
+                Value(m.second);
+                out.members.push_back(m);
+                Skip();
+            } while (ok && *p == ',' && p++);
+            Expect('}');
+        }
+        else if (*p == '[') {
+            p++;
+            out.type = Json::ARRAY;
+            Skip();
+            if (*p == ']') { p++; return; }
+            do {
+                out.items.emplace_back();
+                Value(out.items.back());
+                Skip();
+            } while (ok && *p == ',' && p++);
+            Expect(']');
+        }
+        else if (*p == '"') {
+            out.type = Json::STRING;
+            String(out.text);
+        }
+        else if (std::strncmp(p, "true", 4) == 0 || std::strncmp(p, "false", 5) == 0) {
+            out.type = Json::BOOLEAN;
+            out.number = *p == 't';
+            p += *p == 't' ? 4 : 5;
+        }
+        else if (std::strncmp(p, "null", 4) == 0)
+            p += 4;
+        else {
+            char *end;
+            out.type = Json::NUMBER;
+            out.number = std::strtod(p, &end);
+            if (end == p) ok = false;
+            p = end;
+        }
+    }
+};
+
+bool ReadJson(const std::string &path, Json &out) {
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    if (!file || !JsonParser(text.str()).Parse(out)) {
+        std::cout << "ERROR::RUNNER::BAD_JSON " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string Quote(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// ---- Statistics ----
+
+double Median(std::vector<double> v) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// Keeps the samples within 3 scaled median absolute deviations of the median; the rest go to 'rejected'
+std::vector<double> RejectOutliers(const std::vector<double> &samples, std::vector<double> &rejected) {
+    double median = Median(samples);
+    std::vector<double> deviations;
+    for (double x : samples) deviations.push_back(std::fabs(x - median));
+    double limit = 3.0 * 1.4826 * Median(deviations);
+    std::vector<double> kept;
+    for (double x : samples) {
+        if (std::fabs(x - median) <= limit) kept.push_back(x);
+        else rejected.push_back(x);
+    }
+    return kept;
+}
+
+double RelativeChange(double baseline, double current) {
+    if (baseline == 0.0) return current == 0.0 ? 0.0 : HUGE_VAL;
+    return current / baseline - 1.0;
+}
+
+// 95% confidence interval of the relative change of the median, by resampling both sides
+void BootstrapChange(const std::vector<double> &baseline, const std::vector<double> &current, double &low, double &high) {
+    const int RESAMPLES = 10000;
+    std::mt19937 rng(12345); // the same data always gives the same interval
+    std::uniform_int_distribution<size_t> pickBase(0, baseline.size() - 1), pickCurrent(0, current.size() - 1);
+    std::vector<double> changes(RESAMPLES), b(baseline.size()), c(current.size());
+    for (int r = 0; r < RESAMPLES; r++) {
+        for (double &x : b) x = baseline[pickBase(rng)];
+        for (double &x : c) x = current[pickCurrent(rng)];
+        changes[r] = RelativeChange(Median(b), Median(c));
+    }
+    std::sort(changes.begin(), changes.end());
+    low = changes[(size_t)(0.025 * (RESAMPLES - 1))];
+    high = changes[(size_t)(0.975 * (RESAMPLES - 1))];
+}
+
+// ---- Processes ----
+
+// Restricts this process, and so every run it starts, to the listed CPUs
+bool PinToCpus(const std::string &list) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        int first = 0, last = 0;
+        int n = std::sscanf(item.c_str(), "%d-%d", &first, &last);
+        if (n < 1) {
+            std::cout << "ERROR::RUNNER::BAD_CPU_LIST " << list << std::endl;
+            return false;
+        }
+        if (n == 1) last = first;
+        for (int cpu = first; cpu <= last; cpu++) CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        std::cout << "ERROR::RUNNER::CANNOT_PIN " << list << std::endl;
+        return false;
+    }
+    return true;
+#else
+    std::cout << "ERROR::RUNNER::CANNOT_PIN CPU affinity is only supported on Linux, running unpinned" << std::endl;
+    (void)list;
+    return true;
+#endif
+}
+
+// Returns the exit status, -1 if the command could not run
+int Run(const std::vector<std::string> &command) {
+#if defined(_WIN32)
+    std::string line;
+    for (const std::string &arg : command) line += Quote(arg) + " ";
+    return std::system(("\"" + line + "\"").c_str());
+#else
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        std::vector<char*> argv;
+        for (const std::string &arg : command) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        std::perror(argv[0]);
+        _exit(127);
+    }
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+int main(int argc, char **argv) {
+    int warmup = 1, repetitions = 7;
+    std::string cpus, outPath, baselinePath;
+    std::vector<std::string> command;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--") {
+            command.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "ERROR::RUNNER::MISSING_VALUE " << arg << std::endl;
+            return 2;
+        }
+        if (arg == "--warmup") warmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--repetitions") repetitions = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--cpus") cpus = argv[++i];
+        else if (arg == "--out") outPath = argv[++i];
+        else if (arg == "--baseline") baselinePath = argv[++i];
+        else if (arg == "--threshold") {
+            std::string value = argv[++i];
+            size_t eq = value.find('=');
+            MetricSpec *spec = nullptr;
+            for (MetricSpec &m : METRICS)
+                if (eq != std::string::npos && value.compare(0, eq, m.name) == 0 && std::strlen(m.name) == eq) spec = &m;
+            if (!spec) {
+                std::cout << "ERROR::RUNNER::UNKNOWN_METRIC " << value << std::endl;
+                return 2;
+            }
+            spec->threshold = std::atof(value.c_str() + eq + 1);
+        }
+        else {
+            std::cout << "ERROR::RUNNER::UNKNOWN_FLAG " << arg << std::endl;
+            return 2;
+        }
+    }
+    if (command.empty()) {
+        std::cout << "usage: bench_runner [--warmup n] [--repetitions n] [--cpus list] [--out file] [--baseline file]"
+                     " [--threshold metric=percent] -- <game> <args>" << std::endl;
+        return 2;
+    }
+    if (!cpus.empty() && !PinToCpus(cpus)) return 2;
+
+    Json baseline;
+    if (!baselinePath.empty() && !ReadJson(baselinePath, baseline)) return 2;
+
+    // Runs
+    const std::string metricsFile = "bench_runner_metrics.json";
+    std::vector<std::string> run = command;
+    run.push_back("--metrics");
+    run.push_back(metricsFile);
+    std::map<std::string, std::vector<double>> samples;
+    for (int r = 0; r < warmup + repetitions; r++) {
+        std::remove(metricsFile.c_str());
+        int status = Run(run);
+        Json metrics;
+        if (status != 0 || !ReadJson(metricsFile, metrics)) {
+            std::cout << "ERROR::RUNNER::RUN_FAILED run " << r << " exited with " << status << std::endl;
+            return 2;
+        }
+        bool measured = r >= warmup;
+        std::printf("%s %d:", measured ? "run" : "warm-up", measured ? r - warmup + 1 : r + 1);
+        for (const MetricSpec &m : METRICS) {
+            const Json *value = metrics.Get(m.name);
+            if (!value) continue;
+            std::printf(" %s %.3f", m.name, value->number);
+            if (measured) samples[m.name].push_back(value->number);
+        }
+        std::printf("\n");
+    }
+    std::remove(metricsFile.c_str());
+
+    // Outliers, then the comparison
+    std::map<std::string, std::vector<double>> kept, rejected;
+    for (auto &s : samples) kept[s.first] = RejectOutliers(s.second, rejected[s.first]);
+
+    bool regressed = false;
+    std::printf("\n%-14s %12s %12s %9s %22s %9s  %s\n", "metric", "baseline", "current", "change", "95% interval", "limit", "verdict");
+    for (const MetricSpec &m : METRICS) {
+        if (kept[m.name].empty()) continue;
+        const std::vector<double> &current = kept[m.name];
+        const Json *base = baseline.Get("metrics") ? baseline.Get("metrics")->Get(m.name) : nullptr;
+        const Json *baseSamples = base ? base->Get("samples") : nullptr;
+        if (!baseSamples || baseSamples->items.empty()) {
+            std::printf("%-14s %12s %12.3f %9s %22s %9s  %s (%zu rejected)\n", m.name, "-", Median(current), "-", "-", "-",
+                        "no baseline", rejected[m.name].size());
+            continue;
+        }
+        std::vector<double> before;
+        for (const Json &x : baseSamples->items) before.push_back(x.number);
+        double change = RelativeChange(Median(before), Median(current)), low, high;
+        BootstrapChange(before, current, low, high);
+        const char *verdict = "ok";
+        if (low * 100.0 > m.threshold) {
+            verdict = "REGRESSION";
+            regressed = true;
+        }
+        else if (high * 100.0 < -m.threshold) verdict = "improved";
+        char interval[64];
+        std::snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]", low * 100.0, high * 100.0);
+        std::printf("%-14s %12.3f %12.3f %+8.1f%% %22s %8.1f%%  %s (%zu rejected)\n", m.name, Median(before), Median(current),
+                    change * 100.0, interval, m.threshold, verdict, rejected[m.name].size());
+    }
+    if (!baselinePath.empty()) {
+        const Json *baseCommand = baseline.Get("command");
+        std::string before, now;
+        if (baseCommand) for (const Json &a : baseCommand->items) before += a.text + " ";
+        for (const std::string &a : command) now += a + " ";
+        if (before != now) std::cout << "ERROR::RUNNER::DIFFERENT_COMMAND baseline ran: " << before << std::endl;
+    }
+
+    if (!outPath.empty()) {
+        std::ofstream file(outPath);
+        file.precision(10);
+        file << "{\n  \"command\": [";
+        for (size_t i = 0; i < command.size(); i++) file << (i ? ", " : "") << Quote(command[i]);
+        file << "],\n  \"warmup\": " << warmup << ",\n  \"repetitions\": " << repetitions << ",\n  \"cpus\": " << Quote(cpus)
+             << ",\n  \"metrics\": {";
+        bool first = true;
+        for (const MetricSpec &m : METRICS) {
+            if (!samples.count(m.name)) continue;
+            file << (first ? "\n" : ",\n") << "    " << Quote(m.name) << ": {\"median\": " << Median(kept[m.name]) << ", \"samples\": [";
+            first = false;
+            for (size_t i = 0; i < kept[m.name].size(); i++) file << (i ? ", " : "") << kept[m.name][i];
+            file << "], \"rejected\": [";
+            for (size_t i = 0; i < rejected[m.name].size(); i++) file << (i ? ", " : "") << rejected[m.name][i];
+            file << "]}";
+        }
+        file << "\n  }\n}\n";
+        if (!file) {
+            std::cout << "ERROR::RUNNER::CANNOT_WRITE " << outPath << std::endl;
+            return 2;
+        }
+        std::cout << "Result written to " << outPath << std::endl;
+    }
+    return regressed ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Frame time against object count: one headless stress run per size, each appending a row to the CSV.
+# Run from the repository root with the game built with -DHEADLESS_EGL (or -DHEADLESS_OSMESA), e.g.
+#   Benchmarks/stress_sweep.sh ./game stress.csv grid 1000
+# Arguments: executable, CSV file, layout (grid or clusters), projectiles.
+GAME=${1:-./game}
+CSV=${2:-stress.csv}
+LAYOUT=${3:-grid}
+PROJECTILES=${4:-1000}
+for CRATES in 10 100 1000 10000 100000 1000000; do
+    "$GAME" --headless 300 --stress "$CRATES" --stress-layout "$LAYOUT" --stress-mix 1:1:1 \
+        --projectiles "$PROJECTILES" --stress-csv "$CSV" || exit 1
+done
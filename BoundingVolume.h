@@ -2,7 +2,6 @@
 #define BOUNDINGVOLUME_H
 
 #include <glm/glm.hpp>
-#include "Objects.h"
 
 class BoundingVolume {
 public:
@@ -26,6 +25,18 @@ public:
         min = pos - glm::vec3(rad);
         max = pos + glm::vec3(rad);
     }
+
+    // World bounds of a local box [lmin, lmax] placed with the given model matrix.
+    void Calculate(const glm::mat4 &model, const glm::vec3 &lmin, const glm::vec3 &lmax) {
+        min = glm::vec3(1e30f);
+        max = glm::vec3(-1e30f);
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? lmax.x : lmin.x, (i & 2) ? lmax.y : lmin.y, (i & 4) ? lmax.z : lmin.z);
+            glm::vec3 w = glm::vec3(model * glm::vec4(corner, 1.0f));
+            min = glm::min(min, w);
+            max = glm::max(max, w);
+        }
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#ifndef BOUNDSSTORE_H
+#define BOUNDSSTORE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define BOUNDS_SSE 1
+#endif
+#if defined(__AVX__)
+#define BOUNDS_AVX 1
+#endif
+
+#include "Arena.h"
+#include "BoundingVolume.h"
+
+// Axis aligned boxes stored as separate min/max x/y/z arrays so one query box can be tested against
+// eight stored boxes per instruction. Storage is padded to a multiple of eight with empty boxes
+// (min > max) that never overlap anything.
+class BoundsStore {
+public:
+    static const size_t LANES = 8;
+    static const size_t ALL_BLOCKS = SIZE_MAX;
+    static const size_t QUERY_CHUNK_BLOCKS = 128; // masks ForEachOverlap keeps on the stack at once
+
+    typedef std::vector<float, ArenaAllocator<float>> Lane;
+    Lane minX, minY, minZ, maxX, maxY, maxZ;
+
+    size_t Size() const { return count; }
+
+    // Moves the storage into an arena (nullptr: the heap). Clears the store.
+    void Bind(Arena *arena) {
+        for (Lane *l : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+            *l = Lane(ArenaAllocator<float>(arena));
+        count = 0;
+    }
+
+    void Reserve(size_t n) {
+        size_t padded = (n + LANES - 1) / LANES * LANES;
+        for (Lane *l : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+            l->reserve(padded);
+    }
+    size_t Blocks() const { return (count + LANES - 1) / LANES; }
+
+    void Clear() {
+        count = 0;
+        Resize(0);
+    }
+
+    size_t Add(const BoundingBox &b) {
+        size_t i = count++;
+        Resize(count);
+        Set(i, b);
+        return i;
+    }
+
+    void Set(size_t i, const BoundingBox &b) {
+        minX[i] = b.min.x; minY[i] = b.min.y; minZ[i] = b.min.z;
+        maxX[i] = b.max.x; maxY[i] = b.max.y; maxZ[i] = b.max.z;
+    }
+
+    // Moves the last box into slot i and drops the last slot.
+    void SwapRemove(size_t i) {
+        size_t last = count - 1;
+        if (i != last) Set(i, Get(last));
+        count = last;
+        Resize(count);
+    }
+
+    BoundingBox Get(size_t i) const {
+        BoundingBox b;
+        b.min = glm::vec3(minX[i], minY[i], minZ[i]);
+        b.max = glm::vec3(maxX[i], maxY[i], maxZ[i]);
+        return b;
+    }
+
+    // Writes one byte per block of eight boxes in [begin, end), bit i of masks[block - begin] set when box
+    // block*8+i overlaps q.
+    void Overlap(const BoundingBox &q, uint8_t *masks, size_t begin = 0, size_t end = ALL_BLOCKS) const {
+#if defined(BOUNDS_AVX)
+        OverlapAVX(q, masks, begin, end);
+#elif defined(BOUNDS_SSE)
+        OverlapSSE(q, masks, begin, end);
+#else
+        OverlapScalar(q, masks, begin, end);
+#endif
+    }
+
+    // Calls f(index) for every stored box overlapping q. The masks live on the caller's stack, a chunk of
+    // blocks at a time, so any number of threads can query one store at once.
+    template <typename F>
+    void ForEachOverlap(const BoundingBox &q, F f) const {
+        uint8_t masks[QUERY_CHUNK_BLOCKS];
+        for (size_t begin = 0; begin < Blocks(); begin += QUERY_CHUNK_BLOCKS) {
+            size_t end = std::min(begin + QUERY_CHUNK_BLOCKS, Blocks());
+            Overlap(q, masks, begin, end);
+            for (size_t block = begin; block < end; block++) {
+                unsigned int m = masks[block - begin];
+                while (m) {
+                    unsigned int bit = CountTrailingZeros(m);
+                    f(block * LANES + bit);
+                    m &= m - 1;
+                }
+            }
+        }
+    }
+
+    void OverlapScalar(const BoundingBox &q, uint8_t *masks, size_t begin = 0, size_t end = ALL_BLOCKS) const {
+        end = std::min(end, Blocks());
+        for (size_t block = begin; block < end; block++) {
+            uint8_t m = 0;
+            for (size_t lane = 0; lane < LANES; lane++) {
+                size_t i = block * LANES + lane;
+                bool hit = (minX[i] <= q.max.x && maxX[i] >= q.min.x) &&
+                           (minY[i] <= q.max.y && maxY[i] >= q.min.y) &&
+                           (minZ[i] <= q.max.z && maxZ[i] >= q.min.z);
+                m |= (uint8_t)hit << lane;
+            }
+            masks[block - begin] = m;
+        }
+    }
+
+#if defined(BOUNDS_SSE)
+    void OverlapSSE(const BoundingBox &q, uint8_t *masks, size_t begin = 0, size_t end = ALL_BLOCKS) const {
+        __m128 qminX = _mm_set1_ps(q.min.x), qminY = _mm_set1_ps(q.min.y), qminZ = _mm_set1_ps(q.min.z);
+        __m128 qmaxX = _mm_set1_ps(q.max.x), qmaxY = _mm_set1_ps(q.max.y), qmaxZ = _mm_set1_ps(q.max.z);
+        end = std::min(end, Blocks());
+        for (size_t block = begin; block < end; block++) {
+            unsigned int m = 0;
+            for (size_t half = 0; half < 2; half++) {
+                size_t i = block * LANES + half * 4;
+                __m128 r = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&minX[i]), qmaxX), _mm_cmpge_ps(_mm_loadu_ps(&maxX[i]), qminX));
+                r = _mm_and_ps(r, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&minY[i]), qmaxY), _mm_cmpge_ps(_mm_loadu_ps(&maxY[i]), qminY)));
+                r = _mm_and_ps(r, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&minZ[i]), qmaxZ), _mm_cmpge_ps(_mm_loadu_ps(&maxZ[i]), qminZ)));
+                m |= (unsigned int)_mm_movemask_ps(r) << (half * 4);
+            }
+            masks[block - begin] = (uint8_t)m;
+        }
+    }
+#endif
+
+#if defined(BOUNDS_AVX)
+    void OverlapAVX(const BoundingBox &q, uint8_t *masks, size_t begin = 0, size_t end = ALL_BLOCKS) const {
+        __m256 qminX = _mm256_set1_ps(q.min.x), qminY = _mm256_set1_ps(q.min.y), qminZ = _mm256_set1_ps(q.min.z);
+        __m256 qmaxX = _mm256_set1_ps(q.max.x), qmaxY = _mm256_set1_ps(q.max.y), qmaxZ = _mm256_set1_ps(q.max.z);
+        end = std::min(end, Blocks());
+        for (size_t block = begin; block < end; block++) {
+            size_t i = block * LANES;
+            __m256 r = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&minX[i]), qmaxX, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(&maxX[i]), qminX, _CMP_GE_OQ));
+            r = _mm256_and_ps(r, _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&minY[i]), qmaxY, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(&maxY[i]), qminY, _CMP_GE_OQ)));
+            r = _mm256_and_ps(r, _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&minZ[i]), qmaxZ, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(&maxZ[i]), qminZ, _CMP_GE_OQ)));
+            masks[block - begin] = (uint8_t)_mm256_movemask_ps(r);
+        }
+    }
+#endif
+
+    static unsigned int CountTrailingZeros(unsigned int m) {
+#if defined(__GNUC__) || defined(__clang__)
+        return (unsigned int)__builtin_ctz(m);
+#else
+        unsigned int n = 0;
+        while (!(m & 1u)) { m >>= 1; n++; }
+        return n;
+#endif
+    }
+
+private:
+    size_t count = 0;
+
+    void Resize(size_t n) {
+        size_t padded = (n + LANES - 1) / LANES * LANES;
+        // padding lanes hold an inverted box so they never report an overlap
+        minX.resize(padded, 1e30f); minY.resize(padded, 1e30f); minZ.resize(padded, 1e30f);
+        maxX.resize(padded, -1e30f); maxY.resize(padded, -1e30f); maxZ.resize(padded, -1e30f);
+        for (size_t i = n; i < padded; i++) {
+            minX[i] = minY[i] = minZ[i] = 1e30f;
+            maxX[i] = maxY[i] = maxZ[i] = -1e30f;
+        }
+    }
+};
+
+#endif
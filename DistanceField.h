@@ -0,0 +1,287 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "Objects.h"
+
+// A static mesh placed in the world, as input to the distance field.
+struct SDFSource {
+    const Mesh *mesh;
+    glm::mat4 toWorld;
+    glm::mat4 toLocal;
+    float scale; // uniform scale of toWorld
+};
+
+// Sparse bricked signed distance field of static geometry. The domain is a lattice of samples 'voxelSize'
+// apart, grouped in bricks of 8x8x8 cells. Only bricks within 'band' of a surface store samples (9^3 with
+// shared borders, so a trilinear lookup never leaves its brick), the rest keep a single coarse distance.
+// Distances are negative behind a surface, following the face normal of the closest triangle.
+class DistanceField {
+public:
+    static const int BRICK = 8;
+    static const int BRICK_SAMPLES = BRICK + 1;
+    static const int SAMPLES_PER_BRICK = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+
+    glm::vec3 origin;
+    float voxelSize = 0.25f;
+    float band = 1.0f;
+    glm::ivec3 bricks;                // brick count per axis
+    std::vector<int32_t> brickIndex;  // -1 when the brick is empty
+    std::vector<float> brickCoarse;   // distance at the brick center, used for empty bricks
+    std::vector<float> samples;       // SAMPLES_PER_BRICK per allocated brick
+    uint64_t sourceHash = 0;
+
+    bool Empty() const { return brickIndex.empty(); }
+
+    // Adds the meshes of an asset placed with the given transform.
+    static void AddSource(std::vector<SDFSource> &sources, const Model &asset, const glm::mat4 &toWorld, float uniformScale) {
+        for (auto &mesh : asset.m) {
+            if (!mesh.bvh || mesh.bvh->Empty()) continue;
+            SDFSource s;
+            s.mesh = &mesh;
+            s.toWorld = toWorld;
+            s.toLocal = glm::inverse(toWorld);
+            s.scale = uniformScale;
+            sources.push_back(s);
+        }
+    }
+
+    static uint64_t HashSources(const std::vector<SDFSource> &sources, float voxelSize, float band) {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void *data, size_t bytes) {
+            const unsigned char *p = (const unsigned char*)data;
+            for (size_t i = 0; i < bytes; i++) { h ^= p[i]; h *= 1099511628211ull; }
+        };
+        mix(&voxelSize, sizeof(float));
+        mix(&band, sizeof(float));
+        for (auto &s : sources) {
+            mix(&s.mesh->bvh->sourceHash, sizeof(uint64_t));
+            mix(&s.toWorld[0][0], sizeof(glm::mat4));
+        }
+        return h;
+    }
+
+    // Both passes are split over 'jobs' when given
+    void Build(const std::vector<SDFSource> &sources, JobSystem *jobs = nullptr, float voxelSize = 0.25f, float band = 1.0f) {
+        this->voxelSize = voxelSize;
+        this->band = band;
+        sourceHash = HashSources(sources, voxelSize, band);
+        brickIndex.clear();
+        brickCoarse.clear();
+        samples.clear();
+        if (sources.empty()) return;
+
+        glm::vec3 wmin(1e30f), wmax(-1e30f);
+        for (auto &s : sources) {
+            BoundingBox b;
+            b.Calculate(s.toWorld, s.mesh->bvh->nodes[0].bmin, s.mesh->bvh->nodes[0].bmax);
+            wmin = glm::min(wmin, b.min);
+            wmax = glm::max(wmax, b.max);
+        }
+        origin = wmin - glm::vec3(2.0f * band);
+        glm::vec3 extent = wmax + glm::vec3(2.0f * band) - origin;
+        float brickSize = voxelSize * BRICK;
+        bricks = glm::ivec3((int)std::ceil(extent.x / brickSize), (int)std::ceil(extent.y / brickSize), (int)std::ceil(extent.z / brickSize));
+
+        size_t brickCount = (size_t)bricks.x * bricks.y * bricks.z;
+        brickIndex.assign(brickCount, -1);
+        brickCoarse.assign(brickCount, 0.0f);
+
+        // classify bricks, then fill the ones near a surface
+        float halfDiagonal = 0.5f * brickSize * std::sqrt(3.0f);
+        ParallelFor(jobs, brickCount, 256, [&](size_t b) {
+            glm::vec3 center = BrickOrigin(b) + glm::vec3(0.5f * brickSize);
+            brickCoarse[b] = SignedDistance(sources, center, halfDiagonal + band);
+        });
+        std::vector<size_t> nearBricks;
+        for (size_t b = 0; b < brickCount; b++) {
+            if (std::fabs(brickCoarse[b]) < halfDiagonal + band) {
+                brickIndex[b] = (int32_t)nearBricks.size();
+                nearBricks.push_back(b);
+            }
+        }
+        samples.assign(nearBricks.size() * SAMPLES_PER_BRICK, 0.0f);
+        float searchRadius = 2.0f * halfDiagonal + band;
+        ParallelFor(jobs, nearBricks.size(), 8, [&](size_t n) {
+            glm::vec3 bo = BrickOrigin(nearBricks[n]);
+            float *dst = &samples[n * SAMPLES_PER_BRICK];
+            for (int z = 0; z < BRICK_SAMPLES; z++)
+                for (int y = 0; y < BRICK_SAMPLES; y++)
+                    for (int x = 0; x < BRICK_SAMPLES; x++)
+                        *dst++ = SignedDistance(sources, bo + glm::vec3(x, y, z) * voxelSize, searchRadius);
+        });
+    }
+
+    // Loads the field from path, or builds it and writes it there when the cache is missing or stale.
+    void BuildCached(const std::vector<SDFSource> &sources, const std::string &path, JobSystem *jobs = nullptr,
+                     float voxelSize = 0.25f, float band = 1.0f) {
+        if (Load(path, HashSources(sources, voxelSize, band))) return;
+        Build(sources, jobs, voxelSize, band);
+        if (!Save(path))
+            std::cout << "ERROR::SDF::Could not write cache " << path << std::endl;
+    }
+
+    // Signed distance at p, and optionally its gradient (the outward surface normal near a surface).
+    float Sample(const glm::vec3 &p, glm::vec3 *gradient = nullptr) const {
+        if (brickIndex.empty()) {
+            if (gradient) *gradient = glm::vec3(0.0f, 1.0f, 0.0f);
+            return 1e30f;
+        }
+        glm::vec3 lattice = (p - origin) / voxelSize;
+        glm::vec3 maxLattice = glm::vec3(bricks.x * BRICK, bricks.y * BRICK, bricks.z * BRICK) - glm::vec3(1e-3f);
+        glm::vec3 clamped = glm::clamp(lattice, glm::vec3(0.0f), maxLattice);
+        float outside = glm::length(clamped - lattice) * voxelSize;
+
+        glm::ivec3 cell(glm::floor(clamped));
+        glm::vec3 f = clamped - glm::vec3(cell.x, cell.y, cell.z);
+        size_t b = ((size_t)(cell.z / BRICK) * bricks.y + cell.y / BRICK) * bricks.x + cell.x / BRICK;
+        int32_t bi = brickIndex[b];
+        if (bi < 0) {
+            if (gradient) *gradient = glm::vec3(0.0f, 1.0f, 0.0f);
+            return brickCoarse[b] + outside;
+        }
+
+        const float *s = &samples[(size_t)bi * SAMPLES_PER_BRICK];
+        int x = cell.x % BRICK, y = cell.y % BRICK, z = cell.z % BRICK;
+        auto at = [&](int dx, int dy, int dz) { return s[((z + dz) * BRICK_SAMPLES + (y + dy)) * BRICK_SAMPLES + (x + dx)]; };
+        float c000 = at(0,0,0), c100 = at(1,0,0), c010 = at(0,1,0), c110 = at(1,1,0);
+        float c001 = at(0,0,1), c101 = at(1,0,1), c011 = at(0,1,1), c111 = at(1,1,1);
+
+        float c00 = c000 + (c100 - c000) * f.x, c10 = c010 + (c110 - c010) * f.x;
+        float c01 = c001 + (c101 - c001) * f.x, c11 = c011 + (c111 - c011) * f.x;
+        float c0 = c00 + (c10 - c00) * f.y, c1 = c01 + (c11 - c01) * f.y;
+        float d = c0 + (c1 - c0) * f.z;
+
+        if (gradient) {
+            // analytic derivative of the trilinear interpolation
+            float gx = ((c100 - c000) * (1 - f.y) + (c110 - c010) * f.y) * (1 - f.z) + ((c101 - c001) * (1 - f.y) + (c111 - c011) * f.y) * f.z;
+            float gy = (c10 - c00) * (1 - f.z) + (c11 - c01) * f.z;
+            float gz = c1 - c0;
+            glm::vec3 g(gx, gy, gz);
+            float len = glm::length(g);
+            *gradient = len > 1e-6f ? g / len : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        return d + outside;
+    }
+
+    bool IntersectSphere(const glm::vec3 &center, float radius, SphereContact &contact) const {
+        glm::vec3 n;
+        float d = Sample(center, &n);
+        if (d >= radius) return false;
+        contact.normal = n;
+        contact.depth = radius - d;
+        contact.point = center - n * d;
+        contact.triangle = 0;
+        return true;
+    }
+
+    bool Save(const std::string &path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return false;
+        uint32_t header[6] = { FILE_MAGIC, FILE_VERSION, (uint32_t)bricks.x, (uint32_t)bricks.y, (uint32_t)bricks.z, (uint32_t)(samples.size() / SAMPLES_PER_BRICK) };
+        out.write((const char*)header, sizeof(header));
+        out.write((const char*)&sourceHash, sizeof(sourceHash));
+        out.write((const char*)&origin, sizeof(origin));
+        out.write((const char*)&voxelSize, sizeof(float));
+        out.write((const char*)&band, sizeof(float));
+        if (!brickIndex.empty()) {
+            out.write((const char*)&brickIndex[0], brickIndex.size() * sizeof(int32_t));
+            out.write((const char*)&brickCoarse[0], brickCoarse.size() * sizeof(float));
+        }
+        if (!samples.empty()) out.write((const char*)&samples[0], samples.size() * sizeof(float));
+        return (bool)out;
+    }
+
+    bool Load(const std::string &path, uint64_t expectedHash) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        uint32_t header[6];
+        uint64_t hash;
+        in.read((char*)header, sizeof(header));
+        in.read((char*)&hash, sizeof(hash));
+        if (!in || header[0] != FILE_MAGIC || header[1] != FILE_VERSION || hash != expectedHash) return false;
+
+        glm::vec3 o;
+        float vs, bd;
+        in.read((char*)&o, sizeof(o));
+        in.read((char*)&vs, sizeof(float));
+        in.read((char*)&bd, sizeof(float));
+        size_t brickCount = (size_t)header[2] * header[3] * header[4];
+        std::vector<int32_t> bi(brickCount);
+        std::vector<float> bc(brickCount);
+        std::vector<float> s((size_t)header[5] * SAMPLES_PER_BRICK);
+        if (brickCount) {
+            in.read((char*)&bi[0], bi.size() * sizeof(int32_t));
+            in.read((char*)&bc[0], bc.size() * sizeof(float));
+        }
+        if (!s.empty()) in.read((char*)&s[0], s.size() * sizeof(float));
+        if (!in) return false;
+        // every brick is empty (-1) or one of the stored ones, else Sample would read past the samples
+        for (int32_t b : bi)
+            if (b < -1 || b >= (int32_t)header[5]) return false;
+
+        origin = o;
+        voxelSize = vs;
+        band = bd;
+        bricks = glm::ivec3((int)header[2], (int)header[3], (int)header[4]);
+        brickIndex.swap(bi);
+        brickCoarse.swap(bc);
+        samples.swap(s);
+        sourceHash = hash;
+        return true;
+    }
+
+private:
+    static const uint32_t FILE_MAGIC = 0x31464453; // "SDF1"
+    static const uint32_t FILE_VERSION = 1;
+
+    glm::vec3 BrickOrigin(size_t b) const {
+        int x = (int)(b % bricks.x);
+        int y = (int)((b / bricks.x) % bricks.y);
+        int z = (int)(b / ((size_t)bricks.x * bricks.y));
+        return origin + glm::vec3(x, y, z) * (voxelSize * BRICK);
+    }
+
+    // Exact distance to the closest triangle within maxDistance, otherwise +maxDistance.
+    static float SignedDistance(const std::vector<SDFSource> &sources, const glm::vec3 &p, float maxDistance) {
+        float best = maxDistance;
+        float sign = 1.0f;
+        for (auto &s : sources) {
+            glm::vec3 local = glm::vec3(s.toLocal * glm::vec4(p, 1.0f));
+            float localRadius = best / s.scale;
+            SphereContact c;
+            if (!s.mesh->bvh->IntersectSphere(local, localRadius, c)) continue;
+            float dist = (localRadius - c.depth) * s.scale;
+            if (dist >= best) continue;
+            best = dist;
+            const std::vector<Vertex> &v = s.mesh->vertices;
+            const std::vector<unsigned int> &idx = s.mesh->indices;
+            glm::vec3 a = v[idx[c.triangle * 3]].Position, e1 = v[idx[c.triangle * 3 + 1]].Position - a, e2 = v[idx[c.triangle * 3 + 2]].Position - a;
+            sign = glm::dot(local - c.point, glm::cross(e1, e2)) < 0.0f ? -1.0f : 1.0f;
+        }
+        return best * sign;
+    }
+
+    // f(i) for i in [0, count), in chunks of 'grain' on the job system, or on this thread without one
+    template <typename F>
+    static void ParallelFor(JobSystem *jobs, size_t count, size_t grain, F f) {
+        if (!jobs) {
+            for (size_t i = 0; i < count; i++) f(i);
+            return;
+        }
+        jobs->Wait(jobs->ParallelFor(count, grain, [&f](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) f(i);
+        }));
+    }
+};
+
+#endif
@@ -0,0 +1,764 @@
+#ifndef ENTITYSTORE_H
+#define ENTITYSTORE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define ENTITY_SSE 1
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#define ENTITY_AVX2 1
+#endif
+
+#include "Arena.h"
+#include "BoundsStore.h"
+#include "Objects.h"
+#include "Raycast.h"
+#include "RenderQueue.h"
+
+// Entities are rows of packed structure-of-arrays component pools. Systems walk the columns they need
+// front to back, so hot per-frame data (transforms, bounds, visibility) stays contiguous and the cold
+// data (names) is never touched by the frame loop.
+//
+// An Entity is a stable handle, not a row: the low bits select a slot that points at the entity's current
+// row, the high bits hold the slot's generation. Removing an entity moves the last row into its place
+// (swap-and-pop) and bumps the generation, so old handles to it are detected by IsValid.
+typedef uint32_t Entity;
+const Entity NO_ENTITY = 0xFFFFFFFF;
+const uint32_t NO_ROW = 0xFFFFFFFF;
+const uint32_t ENTITY_INDEX_BITS = 22;
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+const uint32_t ENTITY_GENERATION_MASK = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+
+enum EntityKind : uint8_t {
+    KIND_STATIC,
+    KIND_CRATE,
+    KIND_PROJECTILE
+};
+
+// Columns keep their storage in the store's level arena (see EntityStore::Bind)
+template <typename T>
+using Column = std::vector<T, ArenaAllocator<T>>;
+
+const float GRAVITY = -9.8f;
+
+struct TransformPool {
+    Column<float> x, y, z, rot, sx, sy, sz;
+    // state of the previous simulation step, for interpolation
+    Column<float> prevX, prevY, prevZ, prevRot;
+    // cached render matrices, rebuilt by UpdateRenderTransforms only while 'dirty' is set. Anything that
+    // writes the transform sets the bit; it clears once the entity has stopped moving between steps.
+    Column<glm::mat4> world;
+    Column<glm::mat3> normal;
+    Column<uint8_t> dirty;
+};
+
+struct BoundsPool {
+    // model space box; entities with a radius use pos +- radius instead (projectiles)
+    Column<float> lminX, lminY, lminZ, lmaxX, lmaxY, lmaxZ;
+    Column<float> radius;
+    BoundsStore world;
+};
+
+struct RenderablePool {
+    Column<Model*> asset; // model providing meshes and textures
+    Column<uint8_t> visible;
+    Column<uint8_t> inView; // written by Cull
+};
+
+// Behaviour pools are sparse: only entities with the behaviour have a row, and each behaviour is one
+// loop over its own rows with no per-entity kind test. 'row' is the entity's row in the store.
+
+// Idle spin and bob of crates
+struct IdlePool {
+    Column<uint32_t> row;
+    Column<float> baseY;
+    Column<float> bobDir;
+};
+
+// Ballistic flight
+struct ProjectilePool {
+    Column<uint32_t> row;
+    Column<float> x0, y0, z0, vx, vy, vz;
+    Column<float> launchTime;
+    Column<uint8_t> active;
+};
+
+class EntityStore {
+public:
+    TransformPool  transform;
+    BoundsPool     bounds;
+    RenderablePool render;
+    IdlePool       idle;
+    ProjectilePool projectiles;
+
+    Column<Entity> entity; // handle of each row
+    Column<uint8_t> kind;
+    Column<uint8_t> alive;
+    Column<uint8_t> inDistanceField; // static geometry already covered by the arena distance field
+    Column<uint32_t> idleRow;        // row in 'idle' or NO_ROW
+    Column<uint32_t> projectileRow;  // row in 'projectiles' or NO_ROW
+
+    Column<const char*> name; // cold, the strings live in the arena
+
+    EntityStore() {}
+    explicit EntityStore(Arena &levelArena) { Bind(levelArena); }
+
+    size_t Size() const { return kind.size(); }
+
+    // Puts every column, the names and the world bounds in the arena. Call while the store is empty.
+    void Bind(Arena &levelArena) {
+        arena = &levelArena;
+        Clear();
+    }
+
+    // Drops all entities without freeing anything; the columns' old storage goes with the arena's Reset().
+    // Unloading a level is store.Clear() followed by a Reset() of its arena.
+    void Clear() {
+        ForEachColumn([this](auto &c) { c = typename std::decay<decltype(c)>::type(Allocator()); });
+        ForEachSlotColumn([this](auto &c) { c = typename std::decay<decltype(c)>::type(Allocator()); });
+        bounds.world.Bind(arena);
+        pendingDestroy.clear();
+        dirtyList.clear();
+        targetsVersion++;
+    }
+
+    // Reserve once at level load so the columns never regrow inside the arena.
+    void Reserve(size_t n) {
+        ForEachColumn([n](auto &c) { c.reserve(n); });
+        ForEachSlotColumn([n](auto &c) { c.reserve(n); });
+        bounds.world.Reserve(n);
+    }
+
+    bool IsValid(Entity e) const {
+        uint32_t slot = e & ENTITY_INDEX_MASK;
+        return e != NO_ENTITY && slot < slotRow.size() && slotRow[slot] != NO_ROW &&
+               slotGeneration[slot] == (e >> ENTITY_INDEX_BITS);
+    }
+
+    // Current row of a valid handle. Rows change when other entities are removed, don't keep them across frames.
+    uint32_t Row(Entity e) const { return slotRow[e & ENTITY_INDEX_MASK]; }
+
+    Entity Create(const std::string &entityName, EntityKind entityKind, Model *asset, glm::vec3 pos, float rot, glm::vec3 scale) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            slot = (uint32_t)slotRow.size();
+            if (slot == ENTITY_INDEX_MASK) {
+                std::cout << "ERROR::ENTITY::OUT_OF_SLOTS" << std::endl;
+                return NO_ENTITY;
+            }
+            slotRow.push_back(NO_ROW);
+            slotGeneration.push_back(0);
+        }
+        uint32_t r = (uint32_t)Size();
+        slotRow[slot] = r;
+        Entity e = (slotGeneration[slot] << ENTITY_INDEX_BITS) | slot;
+
+        transform.x.push_back(pos.x); transform.y.push_back(pos.y); transform.z.push_back(pos.z);
+        transform.rot.push_back(rot);
+        transform.sx.push_back(scale.x); transform.sy.push_back(scale.y); transform.sz.push_back(scale.z);
+        transform.prevX.push_back(pos.x); transform.prevY.push_back(pos.y); transform.prevZ.push_back(pos.z);
+        transform.prevRot.push_back(rot);
+        transform.world.push_back(glm::mat4(1.0f));
+        transform.normal.push_back(glm::mat3(1.0f));
+        transform.dirty.push_back(1);
+
+        glm::vec3 lmin(0.0f), lmax(0.0f);
+        if (asset) asset->LocalBounds(lmin, lmax);
+        bounds.lminX.push_back(lmin.x); bounds.lminY.push_back(lmin.y); bounds.lminZ.push_back(lmin.z);
+        bounds.lmaxX.push_back(lmax.x); bounds.lmaxY.push_back(lmax.y); bounds.lmaxZ.push_back(lmax.z);
+        bounds.radius.push_back(0.0f);
+        bounds.world.Add(BoundingBox());
+
+        render.asset.push_back(asset);
+        render.visible.push_back(asset != nullptr);
+        render.inView.push_back(1);
+
+        entity.push_back(e);
+        kind.push_back(entityKind);
+        alive.push_back(1);
+        inDistanceField.push_back(0);
+        idleRow.push_back(NO_ROW);
+        projectileRow.push_back(NO_ROW);
+        name.push_back(arena ? arena->Copy(entityName) : names.Copy(entityName));
+
+        UpdateBounds(r, r + 1);
+        targetsVersion++;
+        return e;
+    }
+
+    void SetSphereBounds(Entity e, float radius) {
+        uint32_t r = Row(e);
+        bounds.radius[r] = radius;
+        UpdateBounds(r, r + 1);
+    }
+
+    // Spin and bob around the entity's current height.
+    void AddIdle(Entity e) {
+        uint32_t r = Row(e);
+        idleRow[r] = (uint32_t)idle.row.size();
+        idle.row.push_back(r);
+        idle.baseY.push_back(transform.y[r]);
+        idle.bobDir.push_back(-1.0f);
+    }
+
+    void AddProjectile(Entity e) {
+        uint32_t r = Row(e);
+        projectileRow[r] = (uint32_t)projectiles.row.size();
+        projectiles.row.push_back(r);
+        for (auto c : ProjectileColumns())
+            c->push_back(0.0f);
+        projectiles.active.push_back(0);
+    }
+
+    void ReserveProjectiles(size_t n) {
+        projectiles.row.reserve(n);
+        for (auto c : ProjectileColumns())
+            c->reserve(n);
+        projectiles.active.reserve(n);
+    }
+
+    void Launch(Entity e, glm::vec3 pos, glm::vec3 vel, float time) {
+        uint32_t p = projectileRow[Row(e)];
+        projectiles.x0[p] = pos.x; projectiles.y0[p] = pos.y; projectiles.z0[p] = pos.z;
+        projectiles.vx[p] = vel.x; projectiles.vy[p] = vel.y; projectiles.vz[p] = vel.z;
+        projectiles.launchTime[p] = time;
+        projectiles.active[p] = 1;
+    }
+
+    bool InFlight(Entity e) const {
+        uint32_t p = projectileRow[Row(e)];
+        return p != NO_ROW && projectiles.active[p];
+    }
+
+    void StopProjectile(Entity e) {
+        uint32_t p = projectileRow[Row(e)];
+        if (p != NO_ROW) projectiles.active[p] = 0;
+    }
+
+    void SetVisible(Entity e, bool visible) {
+        uint32_t r = Row(e);
+        uint8_t v = visible && alive[r] && render.asset[r];
+        if (render.visible[r] != v) targetsVersion++;
+        render.visible[r] = v;
+    }
+
+    // Moves the entity without interpolating from its old position.
+    void Teleport(Entity e, glm::vec3 pos) {
+        uint32_t r = Row(e);
+        transform.x[r] = transform.prevX[r] = pos.x;
+        transform.y[r] = transform.prevY[r] = pos.y;
+        transform.z[r] = transform.prevZ[r] = pos.z;
+        transform.dirty[r] = 1;
+        UpdateBounds(r, r + 1);
+    }
+
+    // The entity stops updating, colliding and drawing at once; its row is only released by FlushDestroyed at
+    // the end of the frame, so rows seen by loops still running this frame stay put. Stale handles are ignored.
+    void Destroy(Entity e) {
+        if (!IsValid(e)) return;
+        uint32_t r = Row(e);
+        if (!alive[r]) return;
+        alive[r] = 0;
+        render.visible[r] = 0;
+        bounds.world.Set(r, EmptyBox());
+        RemoveIdle(r);
+        if (projectileRow[r] != NO_ROW) projectiles.active[projectileRow[r]] = 0;
+        pendingDestroy.push_back(e);
+        targetsVersion++;
+    }
+
+    // Releases the rows of entities destroyed this frame, O(1) each.
+    void FlushDestroyed() {
+        for (Entity e : pendingDestroy) {
+            if (!IsValid(e)) continue;
+            uint32_t slot = e & ENTITY_INDEX_MASK;
+            RemoveRow(slotRow[slot]);
+            slotRow[slot] = NO_ROW;
+            slotGeneration[slot] = (slotGeneration[slot] + 1) & ENTITY_GENERATION_MASK;
+            freeSlots.push_back(slot);
+        }
+        pendingDestroy.clear();
+    }
+
+    glm::vec3 PositionAt(size_t r) const { return glm::vec3(transform.x[r], transform.y[r], transform.z[r]); }
+    glm::vec3 ScaleAt(size_t r) const { return glm::vec3(transform.sx[r], transform.sy[r], transform.sz[r]); }
+    glm::mat4 ModelMatrixAt(size_t r) const { return Compose(PositionAt(r), transform.rot[r], ScaleAt(r)); }
+
+    glm::vec3 Position(Entity e) const { return PositionAt(Row(e)); }
+    glm::vec3 Scale(Entity e) const { return ScaleAt(Row(e)); }
+    glm::mat4 ModelMatrix(Entity e) const { return ModelMatrixAt(Row(e)); }
+
+    glm::mat4 RenderMatrix(Entity e, float alpha) const {
+        uint32_t r = Row(e);
+        glm::vec3 prev(transform.prevX[r], transform.prevY[r], transform.prevZ[r]);
+        glm::vec3 pos = prev + (PositionAt(r) - prev) * alpha;
+        float delta = transform.rot[r] - transform.prevRot[r];
+        if (delta > 180.0f) delta -= 360.0f;
+        if (delta < -180.0f) delta += 360.0f;
+        return Compose(pos, transform.prevRot[r] + delta * alpha, ScaleAt(r));
+    }
+
+    // ---- Systems ----
+
+    void StorePrevious() {
+        size_t n = Size();
+        if (n == 0) return;
+        std::memcpy(&transform.prevX[0], &transform.x[0], n * sizeof(float));
+        std::memcpy(&transform.prevY[0], &transform.y[0], n * sizeof(float));
+        std::memcpy(&transform.prevZ[0], &transform.z[0], n * sizeof(float));
+        std::memcpy(&transform.prevRot[0], &transform.rot[0], n * sizeof(float));
+    }
+
+    void UpdateIdle(float dt) { UpdateIdle(dt, 0, idle.row.size()); }
+
+    // Idle rows [begin, end)
+    void UpdateIdle(float dt, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            uint32_t i = idle.row[k];
+            float r = transform.rot[i] + SPIN_SPEED * dt;
+            transform.rot[i] = r > 360.0f ? r - 360.0f : r;
+            float y = transform.y[i] + idle.bobDir[k] * BOB_SPEED * dt;
+            transform.y[i] = y;
+            float dir = idle.bobDir[k];
+            dir = y < idle.baseY[k] - 0.5f ? 1.0f : dir;
+            dir = y > idle.baseY[k] + 0.5f ? -1.0f : dir;
+            idle.bobDir[k] = dir;
+            transform.dirty[i] = 1;
+        }
+    }
+
+    // Closed form ballistic flight from the launch state, time is the simulation clock. Projectile rows
+    // [begin, end); ranges write disjoint entities, so they can run on separate jobs.
+    void IntegrateProjectiles(size_t begin, size_t end, float time, float dt) {
+#if defined(ENTITY_AVX2)
+        IntegrateProjectilesAVX2(begin, end, time, dt);
+#else
+        IntegrateProjectilesScalar(begin, end, time, dt);
+#endif
+    }
+
+    void IntegrateProjectilesScalar(size_t begin, size_t end, float time, float dt) {
+        for (size_t p = begin; p < end; p++) {
+            if (!projectiles.active[p]) continue;
+            float t = time - projectiles.launchTime[p];
+            StoreProjectile(p, projectiles.x0[p] + projectiles.vx[p] * t,
+                               projectiles.y0[p] + projectiles.vy[p] * t + 0.5f * GRAVITY * t * t,
+                               projectiles.z0[p] + projectiles.vz[p] * t, dt);
+        }
+    }
+
+#if defined(ENTITY_AVX2)
+    // Eight projectiles per iteration from the launch columns; the results are scattered to the entity rows
+    // of the active lanes.
+    void IntegrateProjectilesAVX2(size_t begin, size_t end, float time, float dt) {
+        const ProjectilePool &q = projectiles;
+        __m256 now = _mm256_set1_ps(time);
+        __m256 halfG = _mm256_set1_ps(0.5f * GRAVITY);
+        alignas(32) float x[8], y[8], z[8];
+        size_t p = begin;
+        for (; p + 8 <= end; p += 8) {
+            uint64_t active;
+            std::memcpy(&active, &q.active[p], 8);
+            if (!active) continue;
+            __m256 t = _mm256_sub_ps(now, _mm256_loadu_ps(&q.launchTime[p]));
+            _mm256_store_ps(x, _mm256_fmadd_ps(_mm256_loadu_ps(&q.vx[p]), t, _mm256_loadu_ps(&q.x0[p])));
+            // y0 + (vy + g/2 t) t
+            _mm256_store_ps(y, _mm256_fmadd_ps(_mm256_fmadd_ps(halfG, t, _mm256_loadu_ps(&q.vy[p])), t, _mm256_loadu_ps(&q.y0[p])));
+            _mm256_store_ps(z, _mm256_fmadd_ps(_mm256_loadu_ps(&q.vz[p]), t, _mm256_loadu_ps(&q.z0[p])));
+            for (int l = 0; l < 8; l++)
+                if (q.active[p + l]) StoreProjectile(p + l, x[l], y[l], z[l], dt);
+        }
+        IntegrateProjectilesScalar(p, end, time, dt);
+    }
+#endif
+
+    // World boxes from the model space boxes. Rotation is about Y only, so the rotated extents have a closed form.
+    void UpdateBounds() { UpdateBounds(0, Size()); }
+
+    void UpdateBounds(size_t begin, size_t end) {
+        BoundsStore &w = bounds.world;
+        for (size_t i = begin; i < end; i++) {
+            float r = bounds.radius[i];
+            if (r > 0.0f) {
+                w.minX[i] = transform.x[i] - r; w.maxX[i] = transform.x[i] + r;
+                w.minY[i] = transform.y[i] - r; w.maxY[i] = transform.y[i] + r;
+                w.minZ[i] = transform.z[i] - r; w.maxZ[i] = transform.z[i] + r;
+                continue;
+            }
+            float a = glm::radians(transform.rot[i]);
+            float c = std::cos(a), s = std::sin(a);
+            float cx = 0.5f * (bounds.lminX[i] + bounds.lmaxX[i]) * transform.sx[i];
+            float cy = 0.5f * (bounds.lminY[i] + bounds.lmaxY[i]) * transform.sy[i];
+            float cz = 0.5f * (bounds.lminZ[i] + bounds.lmaxZ[i]) * transform.sz[i];
+            float hx = 0.5f * (bounds.lmaxX[i] - bounds.lminX[i]) * transform.sx[i];
+            float hy = 0.5f * (bounds.lmaxY[i] - bounds.lminY[i]) * transform.sy[i];
+            float hz = 0.5f * (bounds.lmaxZ[i] - bounds.lminZ[i]) * transform.sz[i];
+            float wx = transform.x[i] + c * cx + s * cz;
+            float wy = transform.y[i] + cy;
+            float wz = transform.z[i] - s * cx + c * cz;
+            float ex = std::fabs(c) * hx + std::fabs(s) * hz;
+            float ez = std::fabs(s) * hx + std::fabs(c) * hz;
+            w.minX[i] = wx - ex; w.maxX[i] = wx + ex;
+            w.minY[i] = wy - hy; w.maxY[i] = wy + hy;
+            w.minZ[i] = wz - ez; w.maxZ[i] = wz + ez;
+        }
+        for (size_t i = begin; i < end; i++)
+            if (!alive[i]) w.Set(i, EmptyBox());
+    }
+
+    // Normalized planes of projection * view, inside where a.x + b.y + c.z + d >= 0
+    struct Frustum {
+        float planes[6][4];
+
+        explicit Frustum(const glm::mat4 &viewProjection) {
+            const glm::mat4 &m = viewProjection;
+            for (int p = 0; p < 6; p++) {
+                int axis = p / 2;
+                float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+                float len = 0.0f;
+                for (int k = 0; k < 4; k++) {
+                    planes[p][k] = m[k][3] + sign * m[k][axis];
+                    if (k < 3) len += planes[p][k] * planes[p][k];
+                }
+                len = std::sqrt(len);
+                for (int k = 0; k < 4; k++) planes[p][k] /= len;
+            }
+        }
+    };
+
+    // Frustum culling of the world boxes against the planes of projection * view. Returns how many visible
+    // rows ended up outside.
+    size_t Cull(const glm::mat4 &viewProjection) { return Cull(Frustum(viewProjection), 0, Size()); }
+
+    size_t Cull(const Frustum &frustum, size_t begin, size_t end) {
+        size_t culled = 0;
+        const float (*planes)[4] = frustum.planes;
+        const BoundsStore &w = bounds.world;
+        for (size_t i = begin; i < end; i++) {
+            uint8_t inside = 1;
+            for (int p = 0; p < 6; p++) {
+                // farthest corner along the plane normal
+                float px = planes[p][0] > 0.0f ? w.maxX[i] : w.minX[i];
+                float py = planes[p][1] > 0.0f ? w.maxY[i] : w.minY[i];
+                float pz = planes[p][2] > 0.0f ? w.maxZ[i] : w.minZ[i];
+                inside &= (planes[p][0] * px + planes[p][1] * py + planes[p][2] * pz + planes[p][3]) >= 0.0f;
+            }
+            render.inView[i] = inside;
+            culled += render.visible[i] && !inside;
+        }
+        return culled;
+    }
+
+    // Rebuilds the cached matrices of dirty entities at the interpolated state. Dirty entities are gathered
+    // first and composed four at a time with SSE; sine and cosine stay scalar.
+    void UpdateRenderTransforms(float alpha) {
+        dirtyList.clear();
+        for (size_t i = 0; i < Size(); i++)
+            if (transform.dirty[i] && render.visible[i]) dirtyList.push_back((uint32_t)i);
+
+        size_t k = 0;
+#if defined(ENTITY_SSE)
+        for (; k + 4 <= dirtyList.size(); k += 4)
+            ComposeBatch(&dirtyList[k], alpha);
+#endif
+        for (; k < dirtyList.size(); k++)
+            ComposeOne(dirtyList[k], alpha);
+
+        for (uint32_t e : dirtyList) {
+            bool settled = transform.x[e] == transform.prevX[e] && transform.y[e] == transform.prevY[e] &&
+                           transform.z[e] == transform.prevZ[e] && transform.rot[e] == transform.prevRot[e];
+            if (settled) transform.dirty[e] = 0;
+        }
+    }
+
+    // Call UpdateRenderTransforms first.
+    void Draw(Shader &sh) {
+        size_t n = Size();
+        for (size_t i = 0; i < n; i++) {
+            if (!render.visible[i] || !render.inView[i]) continue;
+            sh.setMat4("model", transform.world[i]);
+            sh.setMat3("normalMatrix", transform.normal[i]);
+            for (auto &mesh : render.asset[i]->m)
+                mesh.Draw(sh);
+        }
+    }
+
+    // Draw packets for the visible rows in [begin, end), keyed for distance from 'eye'. Touches no GL state and
+    // no transform matrices, so it can run on any thread alongside UpdateRenderTransforms. Replay with
+    // transform.world / transform.normal.
+    void RecordDraws(std::vector<DrawPacket> &out, size_t begin, size_t end, const glm::vec3 &eye) const {
+        for (size_t i = begin; i < end; i++) {
+            if (!render.visible[i] || !render.inView[i]) continue;
+            float dx = transform.x[i] - eye.x, dy = transform.y[i] - eye.y, dz = transform.z[i] - eye.z;
+            float distanceSq = dx * dx + dy * dy + dz * dz;
+            for (const Mesh &mesh : render.asset[i]->m) {
+                DrawPacket p;
+                p.mesh = &mesh;
+                p.material = mesh.MaterialKey();
+                p.transform = (uint32_t)i;
+                p.sortKey = RenderQueue::SortKey(p.material, mesh.vao.ID, distanceSq);
+                out.push_back(p);
+            }
+        }
+    }
+
+    // Ray query over the live, visible entities; hit ids are entity handles. Hidden rows such as parked volley
+    // balls are not targets. The tree is only rebuilt when the set of targets changed since the query was last
+    // built from this store; otherwise its bounds are refitted to where the targets moved.
+    void BuildQuery(SceneQuery &query) const {
+        if (query.version == targetsVersion) {
+            query.Refit([this](uint32_t id) { return bounds.world.Get(Row(id)); });
+            return;
+        }
+        std::vector<SceneQuery::Item> items;
+        items.reserve(Size());
+        for (size_t i = 0; i < Size(); i++) {
+            if (!alive[i] || !render.visible[i]) continue;
+            SceneQuery::Item it;
+            it.id = entity[i];
+            it.box = bounds.world.Get(i);
+            items.push_back(it);
+        }
+        query.Build(items, [this](uint32_t id, const Ray &ray, float &t, glm::vec3 &n) {
+            uint32_t r = Row(id);
+            Model *asset = render.asset[r];
+            if (asset && asset->HasBVH())
+                return asset->IntersectRay(ModelMatrixAt(r), ray, t, n);
+            return BoxRay(bounds.world.Get(r), ray, t, n);
+        });
+        query.version = targetsVersion;
+    }
+
+    // Sphere against the entity in row r: its meshes' triangle BVH when the asset has one, its world box
+    // otherwise (the stress scene's blocks share a model without a BVH).
+    bool IntersectSphereAt(size_t r, const glm::vec3 &center, float radius) const {
+        Model *asset = render.asset[r];
+        if (asset && asset->HasBVH()) {
+            SphereContact contact;
+            return asset->IntersectSphere(ModelMatrixAt(r), transform.sx[r], center, radius, contact);
+        }
+        BoundingBox b = bounds.world.Get(r);
+        glm::vec3 d = center - glm::clamp(center, b.min, b.max);
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    static glm::mat4 Compose(const glm::vec3 &pos, float rot, const glm::vec3 &scale) {
+        glm::mat4 mat = glm::mat4(1.0f);
+        mat = glm::translate(mat, pos);
+        mat = glm::rotate(mat, glm::radians(rot), glm::vec3(0.0f, 1.0f, 0.0f));
+        mat = glm::scale(mat, scale);
+        return mat;
+    }
+
+    static BoundingBox EmptyBox() {
+        BoundingBox b;
+        b.min = glm::vec3(1e30f);
+        b.max = glm::vec3(-1e30f);
+        return b;
+    }
+
+    static bool BoxRay(const BoundingBox &b, const Ray &ray, float &t, glm::vec3 &normal) {
+        glm::vec3 t0 = (b.min - ray.origin) / ray.dir;
+        glm::vec3 t1 = (b.max - ray.origin) / ray.dir;
+        glm::vec3 tsmall = glm::min(t0, t1), tbig = glm::max(t0, t1);
+        int axis = tsmall.x > tsmall.y ? (tsmall.x > tsmall.z ? 0 : 2) : (tsmall.y > tsmall.z ? 1 : 2);
+        float tmin = std::max(tsmall[axis], 0.0f);
+        float tmax = std::min(tbig.x, std::min(tbig.y, tbig.z));
+        if (tmin > tmax || tmin > ray.tMax) return false;
+        t = tmin;
+        normal = glm::vec3(0.0f);
+        normal[axis] = ray.dir[axis] > 0.0f ? -1.0f : 1.0f;
+        return true;
+    }
+
+private:
+    Arena *arena = nullptr;
+    Arena names{ 64 * 1024 }; // name storage when no level arena is bound
+
+    // slot -> row and generation of each handle index, and the slots free for reuse
+    Column<uint32_t> slotRow, slotGeneration, freeSlots;
+    std::vector<Entity> pendingDestroy;
+    std::vector<uint32_t> dirtyList;
+    uint32_t targetsVersion = 1; // bumped whenever an entity becomes or stops being a ray target
+
+    void RemoveIdle(uint32_t r) {
+        uint32_t k = idleRow[r];
+        if (k == NO_ROW) return;
+        idleRow[idle.row.back()] = k;
+        SwapPop(idle.row, k);
+        SwapPop(idle.baseY, k);
+        SwapPop(idle.bobDir, k);
+        idleRow[r] = NO_ROW;
+    }
+
+    void RemoveProjectile(uint32_t r) {
+        uint32_t p = projectileRow[r];
+        if (p == NO_ROW) return;
+        projectileRow[projectiles.row.back()] = p;
+        SwapPop(projectiles.row, p);
+        for (auto c : ProjectileColumns())
+            SwapPop(*c, p);
+        SwapPop(projectiles.active, p);
+        projectileRow[r] = NO_ROW;
+    }
+
+    // Moves the last row into r and shrinks every column by one, then repoints whatever referenced the moved row.
+    void RemoveRow(uint32_t r) {
+        RemoveIdle(r);
+        RemoveProjectile(r);
+        uint32_t last = (uint32_t)Size() - 1;
+        ForEachRowColumn([r](auto &c) { SwapPop(c, r); });
+        bounds.world.SwapRemove(r);
+        if (r == last) return;
+        slotRow[entity[r] & ENTITY_INDEX_MASK] = r;
+        if (idleRow[r] != NO_ROW) idle.row[idleRow[r]] = r;
+        if (projectileRow[r] != NO_ROW) projectiles.row[projectileRow[r]] = r;
+    }
+
+    void StoreProjectile(size_t p, float x, float y, float z, float dt) {
+        uint32_t e = projectiles.row[p];
+        transform.x[e] = x;
+        transform.y[e] = y;
+        transform.z[e] = z;
+        float r = transform.rot[e] + SPIN_SPEED * dt;
+        transform.rot[e] = r > 360.0f ? r - 360.0f : r;
+        transform.dirty[e] = 1;
+    }
+
+    template <typename T>
+    static void SwapPop(Column<T> &c, size_t i) {
+        if (i + 1 != c.size()) c[i] = std::move(c.back());
+        c.pop_back();
+    }
+
+    // translate * rotateY * scale, and its inverse transpose R * S^-1
+    void ComposeOne(uint32_t e, float alpha) {
+        float t = transform.prevRot[e];
+        float delta = transform.rot[e] - t;
+        if (delta > 180.0f) delta -= 360.0f;
+        if (delta < -180.0f) delta += 360.0f;
+        float a = glm::radians(t + delta * alpha);
+        float c = std::cos(a), s = std::sin(a);
+        float sx = transform.sx[e], sy = transform.sy[e], sz = transform.sz[e];
+        glm::mat4 &m = transform.world[e];
+        m[0] = glm::vec4(c * sx, 0.0f, -s * sx, 0.0f);
+        m[1] = glm::vec4(0.0f, sy, 0.0f, 0.0f);
+        m[2] = glm::vec4(s * sz, 0.0f, c * sz, 0.0f);
+        m[3] = glm::vec4(transform.prevX[e] + (transform.x[e] - transform.prevX[e]) * alpha,
+                         transform.prevY[e] + (transform.y[e] - transform.prevY[e]) * alpha,
+                         transform.prevZ[e] + (transform.z[e] - transform.prevZ[e]) * alpha, 1.0f);
+        glm::mat3 &n = transform.normal[e];
+        n[0] = glm::vec3(c / sx, 0.0f, -s / sx);
+        n[1] = glm::vec3(0.0f, 1.0f / sy, 0.0f);
+        n[2] = glm::vec3(s / sz, 0.0f, c / sz);
+    }
+
+#if defined(ENTITY_SSE)
+    void ComposeBatch(const uint32_t *ids, float alpha) {
+        auto gather = [&](const Column<float> &col) { return _mm_setr_ps(col[ids[0]], col[ids[1]], col[ids[2]], col[ids[3]]); };
+        __m128 a = _mm_set1_ps(alpha);
+        __m128 px = _mm_add_ps(gather(transform.prevX), _mm_mul_ps(_mm_sub_ps(gather(transform.x), gather(transform.prevX)), a));
+        __m128 py = _mm_add_ps(gather(transform.prevY), _mm_mul_ps(_mm_sub_ps(gather(transform.y), gather(transform.prevY)), a));
+        __m128 pz = _mm_add_ps(gather(transform.prevZ), _mm_mul_ps(_mm_sub_ps(gather(transform.z), gather(transform.prevZ)), a));
+
+        // shortest way between the two angles
+        __m128 prevRot = gather(transform.prevRot);
+        __m128 delta = _mm_sub_ps(gather(transform.rot), prevRot);
+        __m128 full = _mm_set1_ps(360.0f);
+        delta = _mm_sub_ps(delta, _mm_and_ps(_mm_cmpgt_ps(delta, _mm_set1_ps(180.0f)), full));
+        delta = _mm_add_ps(delta, _mm_and_ps(_mm_cmplt_ps(delta, _mm_set1_ps(-180.0f)), full));
+        __m128 angle = _mm_mul_ps(_mm_add_ps(prevRot, _mm_mul_ps(delta, a)), _mm_set1_ps(glm::radians(1.0f)));
+
+        alignas(16) float ang[4], cs[4], sn[4];
+        _mm_store_ps(ang, angle);
+        for (int l = 0; l < 4; l++) { cs[l] = std::cos(ang[l]); sn[l] = std::sin(ang[l]); }
+        __m128 c = _mm_load_ps(cs), s = _mm_load_ps(sn);
+
+        __m128 sx = gather(transform.sx), sy = gather(transform.sy), sz = gather(transform.sz);
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 isx = _mm_div_ps(one, sx), isy = _mm_div_ps(one, sy), isz = _mm_div_ps(one, sz);
+
+        alignas(16) float m00[4], m02[4], m20[4], m22[4], n00[4], n02[4], n20[4], n22[4];
+        alignas(16) float m11[4], n11[4], tx[4], ty[4], tz[4];
+        _mm_store_ps(m00, _mm_mul_ps(c, sx));
+        _mm_store_ps(m02, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(s, sx)));
+        _mm_store_ps(m20, _mm_mul_ps(s, sz));
+        _mm_store_ps(m22, _mm_mul_ps(c, sz));
+        _mm_store_ps(n00, _mm_mul_ps(c, isx));
+        _mm_store_ps(n02, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(s, isx)));
+        _mm_store_ps(n20, _mm_mul_ps(s, isz));
+        _mm_store_ps(n22, _mm_mul_ps(c, isz));
+        _mm_store_ps(m11, sy);
+        _mm_store_ps(n11, isy);
+        _mm_store_ps(tx, px);
+        _mm_store_ps(ty, py);
+        _mm_store_ps(tz, pz);
+
+        for (int l = 0; l < 4; l++) {
+            glm::mat4 &m = transform.world[ids[l]];
+            m[0] = glm::vec4(m00[l], 0.0f, m02[l], 0.0f);
+            m[1] = glm::vec4(0.0f, m11[l], 0.0f, 0.0f);
+            m[2] = glm::vec4(m20[l], 0.0f, m22[l], 0.0f);
+            m[3] = glm::vec4(tx[l], ty[l], tz[l], 1.0f);
+            glm::mat3 &n = transform.normal[ids[l]];
+            n[0] = glm::vec3(n00[l], 0.0f, n02[l]);
+            n[1] = glm::vec3(0.0f, n11[l], 0.0f);
+            n[2] = glm::vec3(n20[l], 0.0f, n22[l]);
+        }
+    }
+#endif
+
+    ArenaAllocator<char> Allocator() const { return ArenaAllocator<char>(arena); }
+
+    std::vector<Column<float>*> FloatColumns() {
+        return { &transform.x, &transform.y, &transform.z, &transform.rot, &transform.sx, &transform.sy, &transform.sz,
+                 &transform.prevX, &transform.prevY, &transform.prevZ, &transform.prevRot,
+                 &bounds.lminX, &bounds.lminY, &bounds.lminZ, &bounds.lmaxX, &bounds.lmaxY, &bounds.lmaxZ, &bounds.radius };
+    }
+
+    // Every column with one element per entity row
+    template <typename F>
+    void ForEachRowColumn(F f) {
+        for (auto c : FloatColumns()) f(*c);
+        f(transform.world); f(transform.normal); f(transform.dirty);
+        f(render.asset); f(render.visible); f(render.inView);
+        f(entity); f(kind); f(alive); f(inDistanceField); f(idleRow); f(projectileRow); f(name);
+    }
+
+    // Row columns plus the behaviour pools
+    template <typename F>
+    void ForEachColumn(F f) {
+        ForEachRowColumn(f);
+        f(idle.row); f(idle.baseY); f(idle.bobDir);
+        f(projectiles.row);
+        for (auto c : ProjectileColumns()) f(*c);
+        f(projectiles.active);
+    }
+
+    template <typename F>
+    void ForEachSlotColumn(F f) {
+        f(slotRow); f(slotGeneration); f(freeSlots);
+    }
+
+    std::vector<Column<float>*> ProjectileColumns() {
+        return { &projectiles.x0, &projectiles.y0, &projectiles.z0, &projectiles.vx, &projectiles.vy, &projectiles.vz,
+                 &projectiles.launchTime };
+    }
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef FIXEDTIMESTEP_H
+#define FIXEDTIMESTEP_H
+
+#include <algorithm>
+
+// Accumulates real frame time and hands it out in fixed simulation steps, so gameplay advances at the
+// same rate and gives the same results whatever the render rate is. Alpha() is how far the render time
+// lies between the last two simulated states.
+class FixedTimestep {
+public:
+    float step;              // seconds per simulation step
+    float time = 0.0f;       // simulated seconds
+    float accumulator = 0.0f;
+    float maxFrameTime = 0.25f; // longer frames are clamped so a hitch doesn't snowball into more steps
+
+    FixedTimestep(float hz = 60.0f) { SetRate(hz); }
+
+    void SetRate(float hz) { step = 1.0f / hz; }
+
+    void Advance(float frameTime) {
+        accumulator += std::min(std::max(frameTime, 0.0f), maxFrameTime);
+    }
+
+    // Consumes one step if enough time has accumulated.
+    bool Step() {
+        if (accumulator < step) return false;
+        accumulator -= step;
+        time += step;
+        return true;
+    }
+
+    float Alpha() const { return accumulator / step; }
+};
+
+#endif
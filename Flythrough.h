@@ -0,0 +1,84 @@
+#ifndef FLYTHROUGH_H
+#define FLYTHROUGH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Scripted camera path: keyframes of time, position and view angles, joined by a Catmull-Rom spline so
+// the camera passes through every keyframe with continuous velocity.
+//
+// File: one keyframe per line, "time x y z yaw pitch", times increasing; '#' starts a comment.
+struct CameraKey {
+    float time;
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+class Flythrough {
+public:
+    std::vector<CameraKey> keys;
+
+    bool Load(const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "ERROR::FLYTHROUGH::CANNOT_OPEN " << path << std::endl;
+            return false;
+        }
+        keys.clear();
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream in(line);
+            CameraKey k;
+            if (!(in >> k.time >> k.position.x >> k.position.y >> k.position.z >> k.yaw >> k.pitch)) continue;
+            if (!keys.empty() && k.time <= keys.back().time) {
+                std::cout << "ERROR::FLYTHROUGH::TIMES_NOT_INCREASING at " << k.time << " in " << path << std::endl;
+                return false;
+            }
+            keys.push_back(k);
+        }
+        if (keys.size() < 2) {
+            std::cout << "ERROR::FLYTHROUGH::NEEDS_TWO_KEYFRAMES " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    float Duration() const { return keys.empty() ? 0.0f : keys.back().time; }
+
+    // Pose at 'time', held at the ends
+    CameraKey Sample(float time) const {
+        if (time <= keys.front().time) return keys.front();
+        if (time >= keys.back().time) return keys.back();
+        size_t i = std::upper_bound(keys.begin(), keys.end(), time,
+            [](float t, const CameraKey &k) { return t < k.time; }) - keys.begin() - 1;
+        const CameraKey &k0 = keys[i > 0 ? i - 1 : i];
+        const CameraKey &k1 = keys[i];
+        const CameraKey &k2 = keys[i + 1];
+        const CameraKey &k3 = keys[std::min(i + 2, keys.size() - 1)];
+        float t = (time - k1.time) / (k2.time - k1.time);
+
+        CameraKey pose;
+        pose.time = time;
+        pose.position = CatmullRom(k0.position, k1.position, k2.position, k3.position, t);
+        pose.yaw = CatmullRom(k0.yaw, k1.yaw, k2.yaw, k3.yaw, t);
+        pose.pitch = std::min(89.0f, std::max(-89.0f, CatmullRom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, t)));
+        return pose;
+    }
+
+private:
+    template <typename T>
+    static T CatmullRom(const T &p0, const T &p1, const T &p2, const T &p3, float t) {
+        float t2 = t * t, t3 = t2 * t;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2
+                       + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+};
+
+#endif
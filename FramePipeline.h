@@ -0,0 +1,94 @@
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "RenderQueue.h"
+
+// Everything the render thread needs to draw one frame, written once by the simulation thread. Draw
+// packets index the snapshot's own matrix arrays, so nothing in the entity store is read while drawing.
+struct FrameSnapshot {
+    uint64_t frame = 0;
+    double inputTime = 0.0; // when the input this frame was simulated from was sampled
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 eye;
+    std::vector<DrawPacket> packets;
+    std::vector<glm::mat4> world;
+    std::vector<glm::mat3> normal;
+    std::string title;
+    size_t culled = 0;      // visible entities outside the frustum
+    bool last = false;      // the run ends after this frame
+};
+
+// Bounded hand-off of snapshots from the simulation thread to the render thread. 'depth' frames may wait
+// ready ahead of the one being drawn; the simulation thread blocks once they are all full, so it runs at
+// most 'depth' frames ahead. Depth 1 overlaps simulating frame N+1 with drawing frame N.
+class FramePipeline {
+public:
+    explicit FramePipeline(size_t depth = 1) : slots(depth + 1) {
+        for (size_t i = 0; i < slots.size(); i++) free.push_back(i);
+    }
+
+    // Blocks until a slot is free. Returns nullptr once the pipeline is closed.
+    FrameSnapshot *BeginWrite() {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this]() { return closed || !free.empty(); });
+        if (closed) return nullptr;
+        writing = free.front();
+        free.pop_front();
+        return &slots[writing];
+    }
+
+    void EndWrite() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ready.push_back(writing);
+        }
+        changed.notify_all();
+    }
+
+    // Blocks until a frame is ready, oldest first. Returns nullptr once the pipeline is closed.
+    FrameSnapshot *BeginRead() {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this]() { return closed || !ready.empty(); });
+        if (closed) return nullptr;
+        reading = ready.front();
+        ready.pop_front();
+        return &slots[reading];
+    }
+
+    void EndRead() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            free.push_back(reading);
+        }
+        changed.notify_all();
+    }
+
+    // Wakes and releases both sides; later Begin calls return nullptr.
+    void Close() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+private:
+    std::vector<FrameSnapshot> slots;
+    std::deque<size_t> free, ready;
+    size_t writing = 0, reading = 0;
+    bool closed = false;
+    std::mutex lock;
+    std::condition_variable changed;
+};
+
+#endif
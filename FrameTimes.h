@@ -0,0 +1,49 @@
+#ifndef FRAMETIMES_H
+#define FRAMETIMES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Frame durations of one run, summarised as percentiles. A hitch is a frame longer than HITCH_FACTOR
+// times the median, i.e. one the player notices whatever the average frame rate.
+class FrameTimes {
+public:
+    static constexpr double HITCH_FACTOR = 2.0;
+
+    void Add(double seconds) { samples.push_back(seconds); }
+    size_t Count() const { return samples.size(); }
+
+    double Mean() const {
+        double sum = 0.0;
+        for (double s : samples) sum += s;
+        return samples.empty() ? 0.0 : sum / samples.size();
+    }
+
+    // p in [0, 1], nearest rank
+    double Percentile(double p) const {
+        if (samples.empty()) return 0.0;
+        std::vector<double> sorted(samples);
+        size_t rank = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    }
+
+    size_t Hitches() const {
+        double limit = HITCH_FACTOR * Percentile(0.5);
+        return std::count_if(samples.begin(), samples.end(), [limit](double s) { return s > limit; });
+    }
+
+    void Report(const std::string &label, double wallSeconds) const {
+        std::cout << label << ": " << Count() << " frames in " << wallSeconds << " s, frame time p50 "
+                  << Percentile(0.5) * 1000.0 << " ms, p95 " << Percentile(0.95) * 1000.0 << " ms, p99 "
+                  << Percentile(0.99) * 1000.0 << " ms, " << Hitches() << " hitches" << std::endl;
+    }
+
+private:
+    std::vector<double> samples;
+};
+
+#endif
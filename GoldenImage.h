@@ -0,0 +1,77 @@
+#ifndef GOLDENIMAGE_H
+#define GOLDENIMAGE_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 8-bit RGB image, top row first, stored as binary PPM so reference frames need no extra library
+struct Image {
+    unsigned int width = 0, height = 0;
+    std::vector<unsigned char> rgb;
+};
+
+inline bool WritePPM(const std::string &path, const Image &image) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::IMAGE::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write((const char*)image.rgb.data(), image.rgb.size());
+    return (bool)file;
+}
+
+inline bool ReadPPM(const std::string &path, Image &image) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    unsigned int maxValue = 0;
+    if (!(file >> magic >> image.width >> image.height >> maxValue) || magic != "P6" || maxValue != 255) {
+        std::cout << "ERROR::IMAGE::NOT_A_PPM " << path << std::endl;
+        return false;
+    }
+    file.get(); // the single whitespace before the pixels
+    image.rgb.resize((size_t)image.width * image.height * 3);
+    file.read((char*)image.rgb.data(), image.rgb.size());
+    if (!file) {
+        std::cout << "ERROR::IMAGE::TRUNCATED " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+struct ImageDiff {
+    size_t differing = 0; // pixels with a channel off by more than the tolerance
+    size_t pixels = 0;
+    int maxError = 0;     // largest channel difference
+};
+
+// Rasterisation differs slightly between Mesa versions: a channel may be off by 'tolerance' before the
+// pixel counts as differing
+inline ImageDiff Compare(const Image &a, const Image &b, int tolerance) {
+    ImageDiff diff;
+    diff.pixels = (size_t)a.width * a.height;
+    if (a.width != b.width || a.height != b.height) {
+        diff.differing = diff.pixels;
+        diff.maxError = 255;
+        return diff;
+    }
+    for (size_t p = 0; p < diff.pixels; p++) {
+        int worst = 0;
+        for (int c = 0; c < 3; c++)
+            worst = std::max(worst, std::abs((int)a.rgb[p * 3 + c] - (int)b.rgb[p * 3 + c]));
+        if (worst > tolerance) diff.differing++;
+        diff.maxError = std::max(diff.maxError, worst);
+    }
+    return diff;
+}
+
+// Images match when at most a fraction 'allowed' of the pixels differ
+inline bool Matches(const ImageDiff &diff, double allowed) {
+    return diff.differing <= (size_t)(allowed * diff.pixels);
+}
+
+#endif
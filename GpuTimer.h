@@ -0,0 +1,212 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Profiler.h"
+
+// GL_ARB_pipeline_statistics_query, core in 4.6; a 3.3 loader may not define the targets
+#ifndef GL_VERTICES_SUBMITTED_ARB
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+// What the GPU spent on one render pass
+struct GpuPassTiming {
+    const char *name;
+    double ms;           // GL_TIME_ELAPSED
+    uint64_t vertices;   // pipeline statistics, 0 without the extension
+    uint64_t primitives;
+    uint64_t fragments;
+};
+
+// GPU time and pipeline statistics per render pass, optionally per draw, from GL queries. Queries are
+// issued into one of two query sets and read back two frames later, when the GPU has long finished them,
+// so reading never stalls; if a set is still not ready it is dropped rather than waited for. GL thread only.
+//
+// GPU timestamps are mapped onto steady_clock, so passes and draws show up on a "GPU" track of the CPU
+// profiler's trace.
+class GpuTimer {
+public:
+    bool perDraw = false; // also time every draw call (timestamps only)
+
+    // Needs a current context
+    void Init() {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_pipeline_statistics_query") == 0)
+                statistics = true;
+        track = Profiler::NewTrack("GPU");
+        Calibrate();
+    }
+
+    bool HasStatistics() const { return statistics; }
+
+    // Starts frame 'frame': collects the set issued two frames ago and reuses it
+    void BeginFrame(uint64_t frame) {
+        QuerySet &set = sets[frame % 2];
+        if (set.pending) Collect(set);
+        set.pending = false;
+        set.frame = frame;
+        set.passesUsed = 0;
+        set.drawsUsed = 0;
+        current = &set;
+        if (frame % 120 == 0) Calibrate(); // GPU and CPU clocks drift apart
+    }
+
+    void EndFrame() {
+        current->pending = current->passesUsed > 0;
+        current = nullptr;
+    }
+
+    // Passes do not nest: only one GL_TIME_ELAPSED query can be active
+    void BeginPass(const char *name) {
+        if (current->passesUsed == current->passes.size()) current->passes.push_back(NewPassQueries());
+        PassQueries &q = current->passes[current->passesUsed++];
+        q.name = name;
+        glQueryCounter(q.ids[PASS_START], GL_TIMESTAMP);
+        glBeginQuery(GL_TIME_ELAPSED, q.ids[PASS_ELAPSED]);
+        if (statistics) {
+            glBeginQuery(GL_VERTICES_SUBMITTED_ARB, q.ids[PASS_VERTICES]);
+            glBeginQuery(GL_PRIMITIVES_SUBMITTED_ARB, q.ids[PASS_PRIMITIVES]);
+            glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, q.ids[PASS_FRAGMENTS]);
+        }
+    }
+
+    void EndPass() {
+        glEndQuery(GL_TIME_ELAPSED);
+        glQueryCounter(current->passes[current->passesUsed - 1].ids[PASS_END], GL_TIMESTAMP);
+        if (statistics) {
+            glEndQuery(GL_VERTICES_SUBMITTED_ARB);
+            glEndQuery(GL_PRIMITIVES_SUBMITTED_ARB);
+            glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+        }
+    }
+
+    // Brackets one draw when perDraw is set
+    void BeginDraw() {
+        if (!perDraw) return;
+        if (current->drawsUsed == current->draws.size()) {
+            DrawQueries d;
+            glGenQueries(2, d.ids);
+            current->draws.push_back(d);
+        }
+        glQueryCounter(current->draws[current->drawsUsed].ids[0], GL_TIMESTAMP);
+    }
+
+    void EndDraw() {
+        if (!perDraw) return;
+        glQueryCounter(current->draws[current->drawsUsed++].ids[1], GL_TIMESTAMP);
+    }
+
+    // The most recent frame read back, and its number
+    const std::vector<GpuPassTiming> &Passes() const { return results; }
+    uint64_t ResultFrame() const { return resultFrame; }
+    double DrawMs() const { return drawMs; }           // per-draw time summed over that frame
+    unsigned int Dropped() const { return dropped; }   // sets that were not ready in time
+
+    void Release() {
+        for (QuerySet &set : sets) {
+            for (PassQueries &q : set.passes) glDeleteQueries(PASS_QUERIES, q.ids);
+            for (DrawQueries &d : set.draws) glDeleteQueries(2, d.ids);
+            set.passes.clear();
+            set.draws.clear();
+            set.pending = false;
+        }
+    }
+
+private:
+    enum { PASS_START, PASS_END, PASS_ELAPSED, PASS_VERTICES, PASS_PRIMITIVES, PASS_FRAGMENTS, PASS_QUERIES };
+    struct PassQueries {
+        GLuint ids[PASS_QUERIES];
+        const char *name;
+    };
+    struct DrawQueries {
+        GLuint ids[2]; // timestamps before and after
+    };
+    struct QuerySet {
+        std::vector<PassQueries> passes;
+        std::vector<DrawQueries> draws;
+        size_t passesUsed = 0, drawsUsed = 0;
+        uint64_t frame = 0;
+        bool pending = false;
+    };
+
+    QuerySet sets[2];
+    QuerySet *current = nullptr;
+    bool statistics = false;
+    std::vector<GpuPassTiming> results;
+    uint64_t resultFrame = 0;
+    double drawMs = 0.0;
+    unsigned int dropped = 0;
+    ProfileThread *track = nullptr;
+    GLint64 gpuEpoch = 0;
+    std::chrono::steady_clock::time_point cpuEpoch;
+
+    PassQueries NewPassQueries() {
+        PassQueries q;
+        glGenQueries(PASS_QUERIES, q.ids);
+        return q;
+    }
+
+    // Pairs the GPU clock with steady_clock now
+    void Calibrate() {
+        glGetInteger64v(GL_TIMESTAMP, &gpuEpoch);
+        cpuEpoch = std::chrono::steady_clock::now();
+    }
+
+    std::chrono::steady_clock::time_point ToCpu(GLuint64 gpuTime) const {
+        return cpuEpoch + std::chrono::nanoseconds((int64_t)gpuTime - (int64_t)gpuEpoch);
+    }
+
+    void Collect(QuerySet &set) {
+        // Queries finish in order, so the last pass and the last draw being ready means they all are
+        GLuint available = 0, drawAvailable = 1;
+        glGetQueryObjectuiv(set.passes[set.passesUsed - 1].ids[PASS_END], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (set.drawsUsed > 0)
+            glGetQueryObjectuiv(set.draws[set.drawsUsed - 1].ids[1], GL_QUERY_RESULT_AVAILABLE, &drawAvailable);
+        if (!available || !drawAvailable) {
+            dropped++;
+            return;
+        }
+
+        results.clear();
+        for (size_t i = 0; i < set.passesUsed; i++) {
+            const PassQueries &q = set.passes[i];
+            GLuint64 start = 0, end = 0, elapsed = 0, vertices = 0, primitives = 0, fragments = 0;
+            glGetQueryObjectui64v(q.ids[PASS_START], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(q.ids[PASS_END], GL_QUERY_RESULT, &end);
+            glGetQueryObjectui64v(q.ids[PASS_ELAPSED], GL_QUERY_RESULT, &elapsed);
+            // The pass cannot take longer than the timestamps around it. llvmpipe's first elapsed query in a
+            // frame can come back as an absolute time.
+            elapsed = std::min<GLuint64>(elapsed, end - start);
+            if (statistics) {
+                glGetQueryObjectui64v(q.ids[PASS_VERTICES], GL_QUERY_RESULT, &vertices);
+                glGetQueryObjectui64v(q.ids[PASS_PRIMITIVES], GL_QUERY_RESULT, &primitives);
+                glGetQueryObjectui64v(q.ids[PASS_FRAGMENTS], GL_QUERY_RESULT, &fragments);
+            }
+            results.push_back({ q.name, elapsed / 1.0e6, vertices, primitives, fragments });
+            Profiler::RecordTrack(track, q.name, ToCpu(start), ToCpu(start + elapsed));
+        }
+        drawMs = 0.0;
+        for (size_t i = 0; i < set.drawsUsed; i++) {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(set.draws[i].ids[0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(set.draws[i].ids[1], GL_QUERY_RESULT, &end);
+            drawMs += (end - start) / 1.0e6;
+            Profiler::RecordTrack(track, "Draw", ToCpu(start), ToCpu(end));
+        }
+        resultFrame = set.frame;
+    }
+};
+
+#endif
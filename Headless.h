@@ -0,0 +1,203 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Windowless GL 3.3 core context for machines without a display or GPU (Mesa llvmpipe on CI). Pick the
+// backend at build time:
+//   -DHEADLESS_EGL    -lEGL      EGL on the surfaceless Mesa platform, no window system at all
+//   -DHEADLESS_OSMESA -lOSMesa   Mesa's off-screen renderer
+// Either way nothing is presented: frames go to an OffscreenTarget.
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#elif defined(HEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+class HeadlessContext {
+public:
+    ~HeadlessContext() { Destroy(); }
+
+    // Creates the context and makes it current on the calling thread. Prints the reason and returns false
+    // when no backend was built in or the driver refuses a 3.3 core context.
+    bool Create(int width, int height) {
+#if defined(HEADLESS_EGL)
+        (void)width; (void)height;
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)
+                                     : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            std::cout << "ERROR::HEADLESS::EGL_INIT_FAILED" << std::endl;
+            return false;
+        }
+        const EGLint configAttribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config = NULL;
+        EGLint configs = 0;
+        eglChooseConfig(display, configAttribs, &config, 1, &configs);
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        eglBindAPI(EGL_OPENGL_API);
+        // Surfaceless contexts need no config; fall back to none when the platform offers none
+        context = eglCreateContext(display, configs > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "ERROR::HEADLESS::EGL_CONTEXT_FAILED (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+            return false;
+        }
+        return MakeCurrent();
+#elif defined(HEADLESS_OSMESA)
+        const int attribs[] = {
+            OSMESA_FORMAT, OSMESA_RGBA, OSMESA_DEPTH_BITS, 24,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, 3, OSMESA_CONTEXT_MINOR_VERSION, 3,
+            0
+        };
+        context = OSMesaCreateContextAttribs(attribs, NULL);
+        if (!context) {
+            std::cout << "ERROR::HEADLESS::OSMESA_CONTEXT_FAILED" << std::endl;
+            return false;
+        }
+        // OSMesa wants a colour buffer to be current; it is never drawn to, frames go to the FBO
+        this->width = width;
+        this->height = height;
+        buffer.resize((size_t)width * height * 4);
+        return MakeCurrent();
+#else
+        (void)width; (void)height;
+        std::cout << "ERROR::HEADLESS::NO_BACKEND (build with -DHEADLESS_EGL or -DHEADLESS_OSMESA)" << std::endl;
+        return false;
+#endif
+    }
+
+    // Binds the context to the calling thread. A context is current on at most one thread at a time.
+    bool MakeCurrent() {
+#if defined(HEADLESS_EGL)
+        if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return true;
+        std::cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT_FAILED (no EGL_KHR_surfaceless_context?)" << std::endl;
+        return false;
+#elif defined(HEADLESS_OSMESA)
+        if (OSMesaMakeCurrent(context, buffer.data(), GL_UNSIGNED_BYTE, width, height)) return true;
+        std::cout << "ERROR::HEADLESS::OSMESA_MAKE_CURRENT_FAILED" << std::endl;
+        return false;
+#else
+        return false;
+#endif
+    }
+
+    // Unbinds whatever context is current on the calling thread
+    void Release() {
+#if defined(HEADLESS_EGL)
+        if (display != EGL_NO_DISPLAY) eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#elif defined(HEADLESS_OSMESA)
+        OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+#endif
+    }
+
+    void Destroy() {
+#if defined(HEADLESS_EGL)
+        if (display == EGL_NO_DISPLAY) return;
+        Release();
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+#elif defined(HEADLESS_OSMESA)
+        if (!context) return;
+        OSMesaDestroyContext(context);
+        context = NULL;
+#endif
+    }
+
+    // For gladLoadGLLoader
+    static void *ProcAddress(const char *name) {
+#if defined(HEADLESS_EGL)
+        return (void*)eglGetProcAddress(name);
+#elif defined(HEADLESS_OSMESA)
+        return (void*)OSMesaGetProcAddress(name);
+#else
+        (void)name;
+        return NULL;
+#endif
+    }
+
+private:
+#if defined(HEADLESS_EGL)
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#elif defined(HEADLESS_OSMESA)
+    OSMesaContext context = NULL;
+    int width = 0, height = 0;
+    std::vector<unsigned char> buffer;
+#endif
+};
+
+// Colour + depth framebuffer object standing in for the window's default framebuffer
+class OffscreenTarget {
+public:
+    unsigned int width = 0, height = 0;
+
+    // GL thread only. Leaves the target bound.
+    bool Create(unsigned int width, unsigned int height) {
+        this->width = width;
+        this->height = height;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenRenderbuffers(1, &color);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void Bind() const { glBindFramebuffer(GL_FRAMEBUFFER, fbo); }
+
+    // Tightly packed RGB, top row first
+    void Read(std::vector<unsigned char> &rgb) const {
+        std::vector<unsigned char> rows((size_t)width * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+        size_t stride = (size_t)width * 3;
+        rgb.resize(rows.size());
+        for (unsigned int y = 0; y < height; y++)
+            std::copy(rows.begin() + (height - 1 - y) * stride, rows.begin() + (height - y) * stride, rgb.begin() + y * stride);
+    }
+
+    void Destroy() {
+        if (!fbo) return;
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+        fbo = color = depth = 0;
+    }
+
+private:
+    GLuint fbo = 0, color = 0, depth = 0;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free queue for one producer thread and one consumer thread. Push and Pop never block; Push fails
+// when the queue is full. CAPACITY must be a power of two.
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    // Producer only.
+    bool Push(const T &item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAPACITY) return false;
+        items[t & (CAPACITY - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.
+    bool Pop(T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = items[h & (CAPACITY - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{ 0 }; // advanced by the consumer
+    alignas(64) std::atomic<size_t> tail{ 0 }; // advanced by the producer
+    T items[CAPACITY];
+};
+
+enum InputEventType : uint8_t {
+    INPUT_KEY,
+    INPUT_MOUSE_MOVE,
+    INPUT_SCROLL
+};
+
+// One GLFW callback, stamped with Now() when it fired
+struct InputEvent {
+    double time;
+    uint8_t type;
+    int key;     // INPUT_KEY: GLFW key and action
+    int action;
+    float x, y;  // INPUT_MOUSE_MOVE: look offsets, INPUT_SCROLL: wheel offsets
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef INPUTRECORDING_H
+#define INPUTRECORDING_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "InputQueue.h"
+
+// Input recorded as the simulation consumed it: one FRAME record per simulated frame holding its frame
+// time, followed by the events drained that frame. Replaying the same frame times and events through the
+// same code reproduces the run exactly, whatever the wall clock or the render rate does meanwhile.
+//
+// File: a 16 byte header ("INPR", version, simulation rate, record count), then 16 byte records.
+const uint8_t INPUT_FRAME = 0xFF;
+
+struct InputRecord {
+    float time;     // FRAME: frame time; events: seconds between the event and the end of its frame
+    float x, y;
+    int16_t key;
+    uint8_t type;   // InputEventType or INPUT_FRAME
+    uint8_t action;
+};
+static_assert(sizeof(InputRecord) == 16, "InputRecord is written to disk as is");
+
+struct InputRecordingHeader {
+    char magic[4];
+    uint32_t version;
+    float simRate;
+    uint32_t records;
+};
+
+const uint32_t INPUT_RECORDING_VERSION = 1;
+
+class InputRecorder {
+public:
+    void Frame(float frameTime) {
+        InputRecord r = {};
+        r.type = INPUT_FRAME;
+        r.time = frameTime;
+        records.push_back(r);
+    }
+
+    // 'now' is the wall time the frame consuming the event ends at
+    void Event(const InputEvent &ev, double now) {
+        InputRecord r = {};
+        r.type = ev.type;
+        r.time = static_cast<float>(now - ev.time);
+        r.key = static_cast<int16_t>(ev.key);
+        r.action = static_cast<uint8_t>(ev.action);
+        r.x = ev.x;
+        r.y = ev.y;
+        records.push_back(r);
+    }
+
+    bool Save(const std::string &path, float simRate) const {
+        std::ofstream file(path, std::ios::binary);
+        InputRecordingHeader header;
+        std::memcpy(header.magic, "INPR", 4);
+        header.version = INPUT_RECORDING_VERSION;
+        header.simRate = simRate;
+        header.records = static_cast<uint32_t>(records.size());
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)records.data(), records.size() * sizeof(InputRecord));
+        if (!file) {
+            std::cout << "ERROR::RECORDING::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<InputRecord> records;
+};
+
+class InputPlayer {
+public:
+    float simRate = 60.0f;
+
+    bool Load(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        InputRecordingHeader header;
+        if (!file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, "INPR", 4) != 0) {
+            std::cout << "ERROR::RECORDING::NOT_A_RECORDING " << path << std::endl;
+            return false;
+        }
+        if (header.version != INPUT_RECORDING_VERSION) {
+            std::cout << "ERROR::RECORDING::VERSION " << header.version << " in " << path << std::endl;
+            return false;
+        }
+        simRate = header.simRate;
+        records.resize(header.records);
+        if (!file.read((char*)records.data(), records.size() * sizeof(InputRecord))) {
+            std::cout << "ERROR::RECORDING::TRUNCATED " << path << std::endl;
+            return false;
+        }
+        if (records.empty() || records[0].type != INPUT_FRAME) {
+            std::cout << "ERROR::RECORDING::EMPTY " << path << std::endl;
+            return false;
+        }
+        cursor = 0;
+        return true;
+    }
+
+    // Starts the next recorded frame. Returns false once the recording is over.
+    bool NextFrame(float &frameTime) {
+        while (cursor < records.size() && records[cursor].type != INPUT_FRAME) cursor++;
+        if (cursor == records.size()) return false;
+        frameTime = records[cursor++].time;
+        return true;
+    }
+
+    // True once the current frame is the last one recorded
+    bool Finished() const {
+        for (size_t i = cursor; i < records.size(); i++)
+            if (records[i].type == INPUT_FRAME) return false;
+        return true;
+    }
+
+    // The next event of the current frame, stamped relative to 'now' as it was when recorded
+    bool NextEvent(double now, InputEvent &ev) {
+        if (cursor == records.size() || records[cursor].type == INPUT_FRAME) return false;
+        const InputRecord &r = records[cursor++];
+        ev.time = now - r.time;
+        ev.type = r.type;
+        ev.key = r.key;
+        ev.action = r.action;
+        ev.x = r.x;
+        ev.y = r.y;
+        return true;
+    }
+
+private:
+    std::vector<InputRecord> records;
+    size_t cursor = 0;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+
+// Work-stealing thread pool. Every worker owns a deque: it pushes and pops its own jobs at the back and,
+// when it runs dry, steals from the front of another worker's deque. The thread that created the pool is
+// worker 0 and only runs jobs while it is inside Wait(), so it stays free for GL submission otherwise.
+//
+// Jobs can depend on other jobs: a job is queued once every job it depends on has finished. ParallelFor
+// returns a single job that finishes when all of its chunks have, so it can be used as a dependency.
+struct Job {
+    std::function<void()> work;
+    std::atomic<int> unfinished{ 1 };  // the job itself plus its unfinished children
+    std::atomic<int> waitingOn{ 1 };   // unfinished dependencies, plus one released by Submit
+    std::atomic<bool> done{ false };
+    std::mutex lock;
+    std::vector<std::shared_ptr<Job>> dependents; // guarded by lock
+    std::shared_ptr<Job> parent;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+class JobSystem {
+public:
+    // threads = 0 uses one worker per hardware thread, the calling thread included.
+    explicit JobSystem(unsigned int threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        queues.resize(threads);
+        for (auto &q : queues) q.reset(new WorkerQueue());
+        workerIndex = 0;
+        for (unsigned int i = 1; i < threads; i++)
+            workers.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &w : workers) w.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem &operator=(const JobSystem&) = delete;
+
+    size_t WorkerCount() const { return queues.size(); }
+
+    // A job that runs 'work'. It does not run before Submit().
+    JobHandle Create(std::function<void()> work) {
+        JobHandle job = std::make_shared<Job>();
+        job->work = std::move(work);
+        return job;
+    }
+
+    // 'job' will not start before 'dependency' has finished. Call before submitting 'job'.
+    void DependsOn(const JobHandle &job, const JobHandle &dependency) {
+        if (!dependency) return;
+        std::lock_guard<std::mutex> guard(dependency->lock);
+        if (dependency->done) return;
+        job->waitingOn++;
+        dependency->dependents.push_back(job);
+    }
+
+    void Submit(const JobHandle &job) {
+        if (--job->waitingOn == 0) Push(job);
+    }
+
+    // Create, add dependencies and submit in one go.
+    JobHandle Schedule(std::function<void()> work, std::initializer_list<JobHandle> dependencies = {}) {
+        JobHandle job = Create(std::move(work));
+        for (auto &d : dependencies) DependsOn(job, d);
+        Submit(job);
+        return job;
+    }
+
+    // f(begin, end) over [0, count) in chunks of about 'grain' items; grain is rounded to a multiple of eight
+    // so SIMD loops over the range keep whole blocks. The returned job finishes when every chunk has.
+    template <typename F>
+    JobHandle ParallelFor(size_t count, size_t grain, F f, std::initializer_list<JobHandle> dependencies = {}) {
+        grain = std::max<size_t>(8, (grain + 7) / 8 * 8);
+        JobHandle job = Create(nullptr);
+        std::weak_ptr<Job> self = job;
+        job->work = [this, self, count, grain, f]() {
+            JobHandle parent = self.lock();
+            for (size_t begin = 0; begin < count; begin += grain) {
+                size_t end = std::min(count, begin + grain);
+                JobHandle chunk = Create([f, begin, end]() { f(begin, end); });
+                chunk->parent = parent;
+                parent->unfinished++;
+                Submit(chunk);
+            }
+        };
+        for (auto &d : dependencies) DependsOn(job, d);
+        Submit(job);
+        return job;
+    }
+
+    // Runs queued jobs on the calling thread until 'job' has finished.
+    void Wait(const JobHandle &job) {
+        while (!job->done)
+            if (!RunOne()) std::this_thread::yield();
+    }
+
+    // Runs one queued job on the calling thread. False when there was none.
+    bool RunOne() {
+        JobHandle next = Find();
+        if (!next) return false;
+        Execute(next);
+        return true;
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<JobHandle> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> queued{ 0 };
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    bool stop = false; // guarded by sleepLock
+
+    static inline thread_local size_t workerIndex = (size_t)-1;
+
+    void Push(const JobHandle &job) {
+        WorkerQueue &q = *queues[workerIndex < queues.size() ? workerIndex : 0];
+        {
+            std::lock_guard<std::mutex> guard(q.lock);
+            q.jobs.push_back(job);
+        }
+        queued++;
+        wake.notify_one();
+    }
+
+    // Own deque first (newest job, still warm in cache), then the oldest job of another worker.
+    JobHandle Find() {
+        size_t self = workerIndex < queues.size() ? workerIndex : 0;
+        {
+            WorkerQueue &q = *queues[self];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (!q.jobs.empty()) {
+                JobHandle job = q.jobs.back();
+                q.jobs.pop_back();
+                queued--;
+                return job;
+            }
+        }
+        thread_local std::minstd_rand rng((unsigned int)std::hash<std::thread::id>()(std::this_thread::get_id()));
+        size_t start = rng() % queues.size();
+        for (size_t k = 0; k < queues.size(); k++) {
+            size_t victim = (start + k) % queues.size();
+            if (victim == self) continue;
+            WorkerQueue &q = *queues[victim];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (!q.jobs.empty()) {
+                JobHandle job = q.jobs.front();
+                q.jobs.pop_front();
+                queued--;
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    void Execute(const JobHandle &job) {
+        if (job->work) job->work();
+        Finish(job);
+    }
+
+    void Finish(JobHandle job) {
+        while (job && --job->unfinished == 0) {
+            std::vector<JobHandle> ready;
+            {
+                std::lock_guard<std::mutex> guard(job->lock);
+                job->done = true;
+                ready.swap(job->dependents);
+            }
+            for (auto &d : ready)
+                if (--d->waitingOn == 0) Push(d);
+            JobHandle parent = job->parent;
+            job->parent.reset();
+            job = parent;
+        }
+    }
+
+    void WorkerLoop(size_t index) {
+        workerIndex = index;
+        PROFILE_THREAD("Job worker");
+        for (;;) {
+            JobHandle job = Find();
+            if (job) {
+                Execute(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(sleepLock);
+            if (stop) return;
+            wake.wait_for(guard, std::chrono::milliseconds(1), [this]() { return stop || queued > 0; });
+            if (stop) return;
+        }
+    }
+};
+
+#endif
@@ -2,6 +2,8 @@
 #define MESH_H
 
 #include <iostream>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include <glad/glad.h>
@@ -16,8 +18,34 @@
 
 #include "shader_m.h"
 #include "stb_image.h"
+#include "BVH.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "Startup.h"
+
+// Fills 'textureID' with a decoded image and its mipmaps
+void UploadTexture(unsigned int textureID, unsigned char *data, int width, int height, int nrComponents) {
+    GLenum format;
+    if (nrComponents == 1)
+        format = GL_RED;
+    else if (nrComponents == 3)
+        format = GL_RGB;
+    else
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    CountRender(RENDER_BYTES_UPLOADED, (uint64_t)width * height * nrComponents);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
 unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false) {
+    PROFILE_ZONE("TextureFromFile");
     std::string filename = std::string(path);
     filename = directory + '/' + filename;
 
@@ -27,32 +55,41 @@ unsigned int TextureFromFile(const char *path, const std::string &directory, boo
     int width, height, nrComponents;
     unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
     if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
+        UploadTexture(textureID, data, width, height, nrComponents);
     else
-    {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    stbi_image_free(data);
+
+    return textureID;
+}
+
+// A texture that loads through the startup graph: grey until a worker has decoded the file and the context
+// thread has uploaded it. The id is final from the start, so meshes and draw sorting use it right away.
+unsigned int TextureFromFileAsync(const char *path, const std::string &directory) {
+    struct Image {
+        unsigned char *data = nullptr;
+        int width = 0, height = 0, nrComponents = 0;
+    };
+    std::string filename = directory + '/' + path;
+    std::shared_ptr<Image> image = std::make_shared<Image>();
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
+    JobHandle decoded = startup.Add("decode " + filename, [image, filename]() {
+        image->data = stbi_load(filename.c_str(), &image->width, &image->height, &image->nrComponents, 0);
+    });
+    startup.Add("upload " + filename, [image, textureID, filename]() {
+        if (image->data)
+            UploadTexture(textureID, image->data, image->width, image->height, image->nrComponents);
+        else
+            std::cout << "Texture failed to load at path: " << filename << std::endl;
+        stbi_image_free(image->data);
+    }, { decoded }, true);
     return textureID;
 }
 
@@ -68,6 +105,14 @@ struct Texture {
     std::string path;
 };
 
+// A mesh as imported, before anything exists on the GPU: built on a worker, turned into a Mesh on the
+// context thread. Texture ids are 0 until then.
+struct MeshData {
+    std::vector<Vertex>       vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture>      textures;
+};
+
 class VBO {
 public:
     GLuint ID;
@@ -75,6 +120,7 @@ public:
         glGenBuffers(1, &ID);
         glBindBuffer(GL_ARRAY_BUFFER, ID);
         glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(Vertex), &v[0], GL_STATIC_DRAW);
+        CountRender(RENDER_BYTES_UPLOADED, v.size() * sizeof(Vertex));
     }
 
     void Bind() { glBindBuffer(GL_ARRAY_BUFFER, ID); }
@@ -94,7 +140,10 @@ public:
         VBO.UnBind();
     }
 
-    void Bind() { glBindVertexArray(ID); }
+    void Bind() const {
+        CountRender(RENDER_VAO_BINDS);
+        glBindVertexArray(ID);
+    }
     void UnBind() { glBindVertexArray(0); }
     void Delete() { glDeleteVertexArrays(1, &ID); }
 };
@@ -106,6 +155,7 @@ public:
         glGenBuffers(1, &ID);
 	    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
 	    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	    CountRender(RENDER_BYTES_UPLOADED, indices.size() * sizeof(unsigned int));
     }
 
     void Bind() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID); }
@@ -121,7 +171,10 @@ public:
 
     VAO vao;
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) : vertices{vertices}, indices{indices}, textures{textures} { Setup(); }
+    // Optional triangle BVH for narrowphase queries, shared between copies of the mesh.
+    std::shared_ptr<TriangleBVH> bvh;
+
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) : vertices{std::move(vertices)}, indices{std::move(indices)}, textures{std::move(textures)} { Setup(); }
     
     void Setup() {
         vao.Bind();
@@ -139,6 +192,33 @@ public:
     }
     
     void Draw(Shader &shader) {
+        PROFILE_ZONE("Mesh::Draw");
+        BindMaterial(shader);
+        vao.Bind();
+        DrawElements();
+        vao.UnBind();
+    }
+
+    // The draw call itself, with the mesh's VAO bound
+    void DrawElements() const {
+        CountRender(RENDER_DRAW_CALLS);
+        CountRender(RENDER_TRIANGLES, indices.size() / 3);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    }
+
+    // Key for sorting draws by material: the first texture. Meshes with equal keys may still differ in
+    // their other textures, see SameMaterial.
+    uint32_t MaterialKey() const { return textures.empty() ? 0u : textures[0].id; }
+
+    bool SameMaterial(const Mesh &other) const {
+        if (textures.size() != other.textures.size()) return false;
+        for (size_t i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type) return false;
+        return true;
+    }
+
+    // Binds the textures and points the material samplers at them.
+    void BindMaterial(Shader &shader) const {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
@@ -152,13 +232,25 @@ public:
                 number = std::to_string(specularNr++);
 
             shader.setInt(("material." + name + number).c_str(), i);
+            CountRender(RENDER_TEXTURE_BINDS);
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
         glActiveTexture(GL_TEXTURE0);
+    }
 
-        vao.Bind();
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        vao.UnBind();
+    // Builds the BVH, or loads it from cachePath when the cached tree matches this geometry. Large meshes
+    // split the build over 'jobs' when given.
+    void BuildBVH(const std::string &cachePath = "", JobSystem *jobs = nullptr) {
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+
+        bvh = std::make_shared<TriangleBVH>();
+        if (!cachePath.empty() && bvh->Load(cachePath, TriangleBVH::HashGeometry(positions, indices), indices))
+            return;
+        bvh->Build(positions, indices, jobs);
+        if (!cachePath.empty() && !bvh->Save(cachePath))
+            std::cout << "ERROR::BVH::Could not write cache " << cachePath << std::endl;
     }
 };
 
@@ -6,43 +6,20 @@
 
 #define RAD_FOR_BOUNDS 1
 
-class Object {
-public:
-    glm::vec3 pos;
-    float rot;
-    glm::vec3 scale;
-    glm::mat4 model;
-    
-    GLuint index_count;
-    bool Visible = true;
+// Idle animation rates, per second of simulated time
+const float SPIN_SPEED = 60.0f;
+const float BOB_SPEED = 0.6f;
 
-    BoundingBox bx;
-    std::string name;
-
-    virtual void Setup() = 0;
-    virtual void Draw(Shader &sh) = 0;
-    virtual void Update(float t) = 0;
-    virtual void CollisionDetection(std::vector<Object*> vObj) = 0;
-};
-
-// Constants For Interaction
-bool MoveBall = false;
-Object* CollidedObject = nullptr;
-
-class Sphere : public Object {
+// UV sphere mesh; Setup generates it and uploads it to the vertex array
+class Sphere {
 public:
     float radius;
     int slices, stacks;
-
-    //Movement After Launch
-    glm::vec3 pos_ini;
-    glm::vec3 vel_ini;
+    GLuint index_count;
 
     VAO vao;
 
-    Sphere(glm::vec3 pos, glm::vec3 scale, float radius, int slices, int stacks) {
-        this->pos = pos;
-        this->scale = scale;
+    Sphere(float radius, int slices, int stacks) {
         this->radius = radius;
         this->slices = slices;
         this->stacks = stacks;
@@ -102,104 +79,116 @@ public:
         ebo.UnBind();
     }
 
-    void Draw(Shader &sh) {
-        model = glm::mat4(1.0);
-        model = glm::scale(model, glm::vec3(0.5));
-        model = glm::translate(model, pos);
-        sh.setMat4("model", model);
-        if (Visible) {
-            vao.Bind();
-            glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, 0);
-            vao.UnBind();
-        }
-    }
-
-    void Update(float t) {
-        glm::vec3 g(0.0f,-9.8f,0.0f);
-        pos.x = pos_ini.x + vel_ini.x * t + 0.5 * g.x * t * t;
-        pos.y = pos_ini.y + vel_ini.y * t + 0.5 * g.y * t * t;
-        pos.z = pos_ini.z + vel_ini.z * t + 0.5 * g.z * t * t;
-    }
-
-    void CollisionDetection(std::vector<Object*> vObj) {
-
-    }
 };
 
-class Model : public Object {
+// An asset: the meshes and textures of one model file, with their BVHs. Entities in the EntityStore place it
+// in the world, so every query takes the transform of the instance.
+class Model {
 public:
     std::vector<Mesh> m;
     std::string dir;
     std::string filepath;
     std::vector<Texture> textures_loaded;
+    std::vector<MeshData> imported; // from Import until Upload
 
-    //Movement After Launch
-    glm::vec3 pos_ini;
-    glm::vec3 vel_ini;
-
-    //For Idle Movement
-    bool idleMovement = true;
-    float firstPosY;
-
-    Model(glm::vec3 pos, float rot, glm::vec3 scale, char *path, std::string name) {
-        this->pos = pos;
-        this->rot = rot;
-        this->scale = scale;
-        filepath = path;
-        this->name = name;
-        firstPosY = pos.y;
-    }
+    explicit Model(const std::string &path) : filepath(path) {}
 
     void Setup() {
+        Import();
+        Upload();
+    }
+
+    // CPU half of Setup: reads the file and builds the meshes' vertices and indices. No GL calls, so models
+    // can import on worker threads at the same time; each import has its own Assimp::Importer.
+    void Import() {
         loadModel(filepath);
     }
 
-    void Draw(Shader &sh) {
-        for(unsigned int i = 0; i < m.size(); i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pos);
-            model = glm::rotate(model, glm::radians(rot), glm::vec3(0.0f,1.0f,0.0f));
-            model = glm::scale(model, scale);
-            sh.setMat4("model", model);
-            m[i].Draw(sh);
-        }
+    // GL half, on the context thread: buffers and textures for what Import read
+    void Upload() {
+        for (auto &data : imported)
+            m.push_back(createMesh(data));
+        imported.clear();
+        imported.shrink_to_fit();
     }
 
-    void Update(float t) {
-        if (name == "box") {
-            rot += 1; if (rot > 360) { rot = 0.0f; }
-            if (idleMovement) {
-                pos.y -= 0.01;
-                if (pos.y < firstPosY - 0.5) { idleMovement = !idleMovement; }
-            }
-            else if (!idleMovement) {
-                pos.y += 0.01;
-                if (pos.y > firstPosY + 0.5) { idleMovement = !idleMovement; }
+    // Builds a triangle BVH for every mesh, cached next to the model file. Meant for static geometry,
+    // call it before other models copy 'm' so the trees are shared.
+    void BuildBVH(JobSystem *jobs = nullptr) {
+        for (unsigned int i = 0; i < m.size(); i++)
+            m[i].BuildBVH(filepath + "." + std::to_string(i) + ".bvh", jobs);
+    }
+
+    bool HasBVH() const {
+        for (auto &mesh : m)
+            if (mesh.bvh && !mesh.bvh->Empty()) return true;
+        return false;
+    }
+
+    // Sphere vs the meshes placed by 'toWorld', in world space. Assumes a uniform scale so the sphere stays a
+    // sphere in model space.
+    bool IntersectSphere(const glm::mat4 &toWorld, float uniformScale, const glm::vec3 &center, float radius, SphereContact &contact) const {
+        glm::mat4 toLocal = glm::inverse(toWorld);
+        glm::vec3 localCenter = glm::vec3(toLocal * glm::vec4(center, 1.0f));
+        float localRadius = radius / uniformScale;
+
+        bool hit = false;
+        SphereContact best;
+        best.depth = -1e30f;
+        for (auto &mesh : m) {
+            SphereContact c;
+            if (mesh.bvh && mesh.bvh->IntersectSphere(localCenter, localRadius, c) && c.depth > best.depth) {
+                best = c;
+                hit = true;
             }
         }
-        else if (name == "ball") {
-            if (MoveBall) {
-                glm::vec3 g(0.0f,-9.8f,0.0f);
-                pos.x = pos_ini.x + vel_ini.x * t + 0.5 * g.x * t * t;
-                pos.y = pos_ini.y + vel_ini.y * t + 0.5 * g.y * t * t;
-                pos.z = pos_ini.z + vel_ini.z * t + 0.5 * g.z * t * t;
-                rot += 1; if (rot > 360) { rot = 0.0f; }
+        if (!hit) return false;
+
+        contact.point = glm::vec3(toWorld * glm::vec4(best.point, 1.0f));
+        contact.normal = glm::normalize(glm::mat3(glm::transpose(toLocal)) * best.normal);
+        contact.depth = best.depth * uniformScale;
+        contact.triangle = best.triangle;
+        return true;
+    }
+
+    // Closest hit of a world space ray against the meshes placed by 'toWorld'. The returned t is in world units
+    // of ray.dir.
+    bool IntersectRay(const glm::mat4 &toWorld, const Ray &ray, float &tHit, glm::vec3 &normal) const {
+        glm::mat4 toLocal = glm::inverse(toWorld);
+        Ray local(glm::vec3(toLocal * glm::vec4(ray.origin, 1.0f)), glm::vec3(toLocal * glm::vec4(ray.dir, 0.0f)), ray.tMax);
+
+        bool hit = false;
+        for (auto &mesh : m) {
+            float t;
+            uint32_t tri;
+            if (mesh.bvh && mesh.bvh->Raycast(local, t, tri)) {
+                local.tMax = t;
+                unsigned int i0 = mesh.indices[tri * 3], i1 = mesh.indices[tri * 3 + 1], i2 = mesh.indices[tri * 3 + 2];
+                glm::vec3 n = glm::cross(mesh.vertices[i1].Position - mesh.vertices[i0].Position,
+                                         mesh.vertices[i2].Position - mesh.vertices[i0].Position);
+                normal = glm::normalize(glm::mat3(glm::transpose(toLocal)) * n);
+                hit = true;
             }
         }
-        bx.Calculate(pos, RAD_FOR_BOUNDS);
+        if (hit) tHit = local.tMax;
+        return hit;
     }
 
-    void CollisionDetection(std::vector<Object*> vObj) {
-        for (auto obj : vObj) {
-            if (bx.Collision(obj->bx)) {
-                if (obj->name == "box") {
-                    CollidedObject = obj;
-                }
+    // Bounds of all meshes in model space. Returns false when nothing is loaded.
+    bool LocalBounds(glm::vec3 &lmin, glm::vec3 &lmax) const {
+        lmin = glm::vec3(1e30f);
+        lmax = glm::vec3(-1e30f);
+        for (auto &mesh : m) {
+            for (auto &v : mesh.vertices) {
+                lmin = glm::min(lmin, v.Position);
+                lmax = glm::max(lmax, v.Position);
             }
         }
+        return lmin.x <= lmax.x;
     }
 
     void loadModel(std::string path) {
+        PROFILE_ZONE("Model::loadModel");
         Assimp::Importer import;
         const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);	
         
@@ -218,7 +207,7 @@ public:
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             aiMesh *mesh = scene->mMeshes[node->mMeshes[i]]; 
-            m.push_back(processMesh(mesh, scene));			
+            imported.push_back(importMesh(mesh, scene));
         }
         // then do the same for each of its children
         for(unsigned int i = 0; i < node->mNumChildren; i++)
@@ -228,10 +217,18 @@ public:
     }
 
     Mesh processMesh(aiMesh *mesh, const aiScene *scene) {
+        MeshData data = importMesh(mesh, scene);
+        return createMesh(data);
+    }
+
+    MeshData importMesh(aiMesh *mesh, const aiScene *scene) {
         // data to fill
-        std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
-        std::vector<Texture> textures;
+        MeshData data;
+        std::vector<Vertex> &vertices = data.vertices;
+        std::vector<unsigned int> &indices = data.indices;
+        std::vector<Texture> &textures = data.textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -306,36 +303,45 @@ public:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return data;
     }
 
-    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName) {
-        std::vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-        {
-            aiString str;
-            mat->GetTexture(type, i, &str);
+    // The GPU side of an imported mesh; its textures are loaded here, once per model
+    Mesh createMesh(MeshData &data) {
+        for (auto &texture : data.textures) {
             bool skip = false;
             for(unsigned int j = 0; j < textures_loaded.size(); j++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                if(textures_loaded[j].path == texture.path)
                 {
-                    textures.push_back(textures_loaded[j]);
+                    texture.id = textures_loaded[j].id;
                     skip = true; 
                     break;
                 }
             }
             if(!skip)
             {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), dir);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
+                texture.id = startup.Running() ? TextureFromFileAsync(texture.path.c_str(), dir) : TextureFromFile(texture.path.c_str(), dir);
                 textures_loaded.push_back(texture); // add to loaded textures
             }
         }
+        // return a mesh object created from the extracted mesh data
+        return Mesh(std::move(data.vertices), std::move(data.indices), std::move(data.textures));
+    }
+
+    // The textures of one type, by file; their ids come with createMesh
+    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName) {
+        std::vector<Texture> textures;
+        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
         return textures;
     }
 };
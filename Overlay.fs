@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D glyphs;
+
+void main()
+{
+    // Text on a translucent dark panel
+    float ink = texture(glyphs, TexCoords).r;
+    FragColor = mix(vec4(0.0, 0.0, 0.0, 0.6), vec4(1.0, 1.0, 0.6, 1.0), ink);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+out vec2 TexCoords;
+
+uniform vec4 rect; // left, bottom, right, top in clip space
+
+void main()
+{
+    // Triangle strip over the rectangle, no vertex buffer needed
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    TexCoords = vec2(corner.x, 1.0 - corner.y);
+    gl_Position = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);
+}
@@ -0,0 +1,232 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+// Scoped-zone CPU profiler. Build with -DPROFILER_ENABLED to compile it in; without it the PROFILE_ macros
+// expand to nothing and Profiler's calls are empty.
+//
+//   PROFILE_ZONE("Cull");      times the enclosing scope
+//   PROFILE_FUNCTION();        same, named after the function
+//   PROFILE_THREAD("Render");  names the calling thread in the trace
+//
+// Each thread records finished zones into its own ring buffer, so recording takes no lock. Zones nest by
+// time: a zone opened inside another shows up below it. Start / Stop toggle the capture at runtime and
+// WriteChromeTrace exports it as Chrome trace JSON, for chrome://tracing or ui.perfetto.dev.
+#if defined(PROFILER_ENABLED)
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC
+#endif
+
+struct ProfileEvent {
+    const char *name; // string literal, never copied
+    uint64_t start, end;
+};
+
+struct ProfileThread {
+    static const size_t CAPACITY = 1 << 16; // the oldest zones are overwritten past this
+    uint32_t id;
+    std::string name;
+    std::atomic<uint64_t> written{ 0 };
+    ProfileEvent events[CAPACITY];
+};
+
+class Profiler {
+public:
+    static const bool Available = true;
+
+    // Time stamp counter where there is one, steady_clock nanoseconds elsewhere
+    static uint64_t Ticks() {
+#if defined(PROFILER_RDTSC)
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static bool Running() { return running.load(std::memory_order_relaxed); }
+
+    // Starts a new capture. Only the owning thread touches a buffer's counter, so earlier zones stay in the
+    // buffers and the export skips them by time. Start, Stop and WriteChromeTrace run on one thread at a time.
+    static void Start() {
+        startTicks = Ticks();
+        startTime = std::chrono::steady_clock::now();
+        running = true;
+    }
+
+    static void Stop() {
+        if (!running) return;
+        running = false;
+        stopTicks = Ticks();
+        stopTime = std::chrono::steady_clock::now();
+    }
+
+    static void SetThreadName(const char *name) { Thread().name = name; }
+
+    static void Record(const char *name, uint64_t start, uint64_t end) {
+        ProfileThread &t = Thread();
+        uint64_t n = t.written.load(std::memory_order_relaxed);
+        t.events[n & (ProfileThread::CAPACITY - 1)] = { name, start, end };
+        t.written.store(n + 1, std::memory_order_release);
+    }
+
+    // A track of its own for zones measured elsewhere, e.g. on the GPU. Only one thread may record on it.
+    static ProfileThread *NewTrack(const char *name) {
+        ProfileThread &t = NewThread();
+        t.name = name;
+        return &t;
+    }
+
+    // Records a zone given in steady_clock time on 'track', converted to ticks at the rate measured since
+    // the capture started
+    static void RecordTrack(ProfileThread *track, const char *name, std::chrono::steady_clock::time_point start,
+                            std::chrono::steady_clock::time_point end) {
+        if (!running) return;
+        auto now = std::chrono::steady_clock::now();
+        uint64_t nowTicks = Ticks();
+        double elapsed = std::chrono::duration<double>(now - startTime).count();
+        if (elapsed <= 0.0) return;
+        double ticksPerSecond = (nowTicks - startTicks) / elapsed;
+        auto toTicks = [&](std::chrono::steady_clock::time_point t) {
+            double s = std::chrono::duration<double>(t - startTime).count();
+            return s < 0.0 ? 0 : startTicks + (uint64_t)(s * ticksPerSecond);
+        };
+        uint64_t n = track->written.load(std::memory_order_relaxed);
+        track->events[n & (ProfileThread::CAPACITY - 1)] = { name, toTicks(start), toTicks(end) };
+        track->written.store(n + 1, std::memory_order_release);
+    }
+
+    // Writes the last capture. Call a while after Stop (e.g. a frame), once zones that were closing on other
+    // threads as it stopped have been recorded.
+    static bool WriteChromeTrace(const std::string &path) {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "ERROR::PROFILER::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        // Ticks to microseconds, measured over the capture itself
+        double us = std::chrono::duration<double, std::micro>(stopTime - startTime).count();
+        double ticksPerUs = us > 0.0 ? (double)(stopTicks - startTicks) / us : 1000.0;
+
+        std::lock_guard<std::mutex> guard(lock);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        size_t zones = 0;
+        for (auto &t : threads) {
+            if (!first) file << ",\n";
+            first = false;
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t->id
+                 << ",\"args\":{\"name\":\"" << Escape(t->name) << "\"}}";
+            uint64_t written = t->written.load(std::memory_order_acquire);
+            uint64_t begin = written > ProfileThread::CAPACITY ? written - ProfileThread::CAPACITY : 0;
+            for (uint64_t i = begin; i < written; i++) {
+                const ProfileEvent &e = t->events[i & (ProfileThread::CAPACITY - 1)];
+                if (e.start < startTicks || e.end > stopTicks) continue;
+                file << ",\n{\"name\":\"" << Escape(e.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t->id
+                     << ",\"ts\":" << (e.start - startTicks) / ticksPerUs << ",\"dur\":" << (e.end - e.start) / ticksPerUs << "}";
+                zones++;
+            }
+        }
+        file << "\n]}\n";
+        std::cout << "Profiler: " << zones << " zones written to " << path << std::endl;
+        return (bool)file;
+    }
+
+private:
+    static std::atomic<bool> running;
+    static uint64_t startTicks, stopTicks;
+    static std::chrono::steady_clock::time_point startTime, stopTime;
+    static std::mutex lock;
+    static std::vector<std::unique_ptr<ProfileThread>> threads; // guarded by lock; kept after threads exit
+
+    static ProfileThread &Thread() {
+        thread_local ProfileThread *self = &NewThread();
+        return *self;
+    }
+
+    static ProfileThread &NewThread() {
+        std::unique_ptr<ProfileThread> t(new ProfileThread());
+        std::lock_guard<std::mutex> guard(lock);
+        t->id = (uint32_t)threads.size();
+        t->name = "Thread " + std::to_string(t->id);
+        threads.push_back(std::move(t));
+        return *threads.back();
+    }
+
+    static std::string Escape(const std::string &s) {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+};
+
+std::atomic<bool> Profiler::running{ false };
+uint64_t Profiler::startTicks = 0, Profiler::stopTicks = 0;
+std::chrono::steady_clock::time_point Profiler::startTime, Profiler::stopTime;
+std::mutex Profiler::lock;
+std::vector<std::unique_ptr<ProfileThread>> Profiler::threads;
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char *name) : name(name), start(Profiler::Running() ? Profiler::Ticks() : 0) {}
+    ~ProfileZone() {
+        if (start && Profiler::Running()) Profiler::Record(name, start, Profiler::Ticks());
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone &operator=(const ProfileZone&) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+
+#else
+
+#include <chrono>
+
+struct ProfileThread;
+
+class Profiler {
+public:
+    static const bool Available = false;
+    static ProfileThread *NewTrack(const char *) { return nullptr; }
+    static void RecordTrack(ProfileThread *, const char *, std::chrono::steady_clock::time_point,
+                            std::chrono::steady_clock::time_point) {}
+    static bool Running() { return false; }
+    static void Start() {}
+    static void Stop() {}
+    static bool WriteChromeTrace(const std::string &) { return false; }
+};
+
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define RAYCAST_SSE 1
+#endif
+
+#include "BVH.h"
+#include "BoundingVolume.h"
+
+struct RayHit {
+    uint32_t id = NO_HIT;
+    float t = 1e30f;
+    glm::vec3 point;
+    glm::vec3 normal;
+
+    static const uint32_t NO_HIT = 0xFFFFFFFF;
+    bool Hit() const { return id != NO_HIT; }
+};
+
+// Eight rays stored as structure of arrays so a node can be tested against all of them at once.
+struct RayPacket {
+    static const int SIZE = 8;
+    // Zeroed so the slab test, which always reads all lanes, never loads garbage past 'count'
+    alignas(32) float ox[SIZE] = {}, oy[SIZE] = {}, oz[SIZE] = {};
+    alignas(32) float dx[SIZE] = {}, dy[SIZE] = {}, dz[SIZE] = {};
+    alignas(32) float ix[SIZE] = {}, iy[SIZE] = {}, iz[SIZE] = {};
+    alignas(32) float tMax[SIZE] = {};
+    int count = 0;
+
+    void Set(int lane, const Ray &r) {
+        ox[lane] = r.origin.x; oy[lane] = r.origin.y; oz[lane] = r.origin.z;
+        dx[lane] = r.dir.x;    dy[lane] = r.dir.y;    dz[lane] = r.dir.z;
+        ix[lane] = 1.0f / r.dir.x; iy[lane] = 1.0f / r.dir.y; iz[lane] = 1.0f / r.dir.z;
+        tMax[lane] = r.tMax;
+        count = std::max(count, lane + 1);
+    }
+
+    Ray Get(int lane) const {
+        return Ray(glm::vec3(ox[lane], oy[lane], oz[lane]), glm::vec3(dx[lane], dy[lane], dz[lane]), tMax[lane]);
+    }
+};
+
+// Ray queries against a set of items identified by an id: a bounding volume hierarchy over their boxes,
+// refined with each item's own narrowphase (triangle BVH for static meshes, the bounding box otherwise).
+class SceneQuery {
+public:
+    // Narrowphase for one item. t is the hit distance in units of ray.dir, only hits before ray.tMax count.
+    typedef std::function<bool(uint32_t id, const Ray &ray, float &t, glm::vec3 &normal)> Narrowphase;
+
+    struct Item {
+        uint32_t id;
+        BoundingBox box;
+    };
+
+    std::vector<BVHNode> nodes;
+    std::vector<Item> items;
+    Narrowphase narrowphase;
+    uint32_t version = 0; // the owner's tag for the item set the tree was built from, 0 before the first Build
+
+    static const int MAX_LEAF_SIZE = 2;
+
+    // Call after the items' bounds were updated for the frame.
+    void Build(const std::vector<Item> &its, Narrowphase np) {
+        items = its;
+        narrowphase = np;
+        nodes.clear();
+        if (items.empty()) return;
+        nodes.reserve(items.size() * 2);
+        BuildRange(0, items.size(), 0);
+    }
+
+    // Same items with moved boxes: boxOf(id) gives each item's new box and the node bounds are recomputed
+    // bottom up, keeping the tree's shape. Children always follow their parent, so one reverse pass does it.
+    // The tree loosens as items drift from where they were split, rebuild when the item set changes.
+    template <typename F>
+    void Refit(F boxOf) {
+        for (Item &it : items)
+            it.box = boxOf(it.id);
+        for (size_t i = nodes.size(); i-- > 0;) {
+            BVHNode &node = nodes[i];
+            glm::vec3 bmin(1e30f), bmax(-1e30f);
+            if (node.IsLeaf()) {
+                for (uint32_t o = node.offset; o < node.offset + node.count; o++) {
+                    bmin = glm::min(bmin, items[o].box.min);
+                    bmax = glm::max(bmax, items[o].box.max);
+                }
+            }
+            else {
+                const BVHNode &left = nodes[i + 1], &right = nodes[node.offset];
+                bmin = glm::min(left.bmin, right.bmin);
+                bmax = glm::max(left.bmax, right.bmax);
+            }
+            node.bmin = bmin;
+            node.bmax = bmax;
+        }
+    }
+
+    bool Closest(const Ray &ray, RayHit &hit) const {
+        hit = RayHit();
+        hit.t = ray.tMax;
+        Traverse(ray, [&](uint32_t id, Ray &r) {
+            float t;
+            glm::vec3 n;
+            if (narrowphase(id, r, t, n) && t < hit.t) {
+                hit.id = id;
+                hit.t = t;
+                hit.normal = n;
+                r.tMax = t;
+            }
+            return false;
+        });
+        if (hit.Hit()) hit.point = ray.origin + ray.dir * hit.t;
+        return hit.Hit();
+    }
+
+    bool Any(const Ray &ray) const {
+        bool found = false;
+        Traverse(ray, [&](uint32_t id, Ray &r) {
+            float t;
+            glm::vec3 n;
+            found = narrowphase(id, r, t, n);
+            return found;
+        });
+        return found;
+    }
+
+    // Every item hit by the ray, nearest first.
+    std::vector<RayHit> All(const Ray &ray) const {
+        std::vector<RayHit> hits;
+        Traverse(ray, [&](uint32_t id, Ray &r) {
+            RayHit h;
+            if (narrowphase(id, r, h.t, h.normal)) {
+                h.id = id;
+                h.point = ray.origin + ray.dir * h.t;
+                hits.push_back(h);
+            }
+            return false;
+        });
+        std::sort(hits.begin(), hits.end(), [](const RayHit &a, const RayHit &b) { return a.t < b.t; });
+        return hits;
+    }
+
+    // Closest hit for every ray of the packet. The top level is traversed once for the whole packet, lanes
+    // that miss a node are masked out with a SIMD slab test.
+    void ClosestPacket(const RayPacket &packet, RayHit hits[RayPacket::SIZE]) const {
+        RayPacket p = packet;
+        unsigned int active = (1u << p.count) - 1;
+        for (int i = 0; i < RayPacket::SIZE; i++) hits[i] = RayHit();
+        for (int i = 0; i < p.count; i++) hits[i].t = p.tMax[i];
+        if (nodes.empty() || active == 0) return;
+
+        uint32_t stack[BVH_STACK_SIZE];
+        int sp = 0;
+        stack[sp++] = 0;
+        while (sp > 0) {
+            uint32_t nodeIndex = stack[--sp];
+            const BVHNode &node = nodes[nodeIndex];
+            unsigned int mask = PacketSlab(node, p) & active;
+            if (!mask) continue;
+            if (!node.IsLeaf()) {
+                stack[sp++] = node.offset;
+                stack[sp++] = nodeIndex + 1;
+                continue;
+            }
+            for (uint32_t o = node.offset; o < node.offset + node.count; o++) {
+                for (int lane = 0; lane < p.count; lane++) {
+                    if (!(mask & (1u << lane))) continue;
+                    Ray r = p.Get(lane);
+                    float t;
+                    glm::vec3 n;
+                    if (narrowphase(items[o].id, r, t, n) && t < p.tMax[lane]) {
+                        p.tMax[lane] = t;
+                        hits[lane].id = items[o].id;
+                        hits[lane].t = t;
+                        hits[lane].normal = n;
+                    }
+                }
+            }
+        }
+        for (int lane = 0; lane < p.count; lane++)
+            if (hits[lane].Hit())
+                hits[lane].point = glm::vec3(p.ox[lane], p.oy[lane], p.oz[lane]) + glm::vec3(p.dx[lane], p.dy[lane], p.dz[lane]) * hits[lane].t;
+    }
+
+    // Bit i is set when ray i of the packet enters the node before its current tMax.
+    static unsigned int PacketSlab(const BVHNode &node, const RayPacket &p) {
+#if defined(__AVX__)
+        __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmin.x), _mm256_load_ps(p.ox)), _mm256_load_ps(p.ix));
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmax.x), _mm256_load_ps(p.ox)), _mm256_load_ps(p.ix));
+        __m256 tmin = _mm256_min_ps(t0, t1), tmax = _mm256_max_ps(t0, t1);
+        t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmin.y), _mm256_load_ps(p.oy)), _mm256_load_ps(p.iy));
+        t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmax.y), _mm256_load_ps(p.oy)), _mm256_load_ps(p.iy));
+        tmin = _mm256_max_ps(tmin, _mm256_min_ps(t0, t1)); tmax = _mm256_min_ps(tmax, _mm256_max_ps(t0, t1));
+        t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmin.z), _mm256_load_ps(p.oz)), _mm256_load_ps(p.iz));
+        t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmax.z), _mm256_load_ps(p.oz)), _mm256_load_ps(p.iz));
+        tmin = _mm256_max_ps(tmin, _mm256_min_ps(t0, t1)); tmax = _mm256_min_ps(tmax, _mm256_max_ps(t0, t1));
+        tmin = _mm256_max_ps(tmin, _mm256_setzero_ps());
+        tmax = _mm256_min_ps(tmax, _mm256_load_ps(p.tMax));
+        return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ));
+#elif defined(RAYCAST_SSE)
+        unsigned int mask = 0;
+        for (int half = 0; half < 2; half++) {
+            int o = half * 4;
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bmin.x), _mm_load_ps(p.ox + o)), _mm_load_ps(p.ix + o));
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bmax.x), _mm_load_ps(p.ox + o)), _mm_load_ps(p.ix + o));
+            __m128 tmin = _mm_min_ps(t0, t1), tmax = _mm_max_ps(t0, t1);
+            t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bmin.y), _mm_load_ps(p.oy + o)), _mm_load_ps(p.iy + o));
+            t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bmax.y), _mm_load_ps(p.oy + o)), _mm_load_ps(p.iy + o));
+            tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1)); tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+            t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bmin.z), _mm_load_ps(p.oz + o)), _mm_load_ps(p.iz + o));
+            t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bmax.z), _mm_load_ps(p.oz + o)), _mm_load_ps(p.iz + o));
+            tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1)); tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+            tmin = _mm_max_ps(tmin, _mm_setzero_ps());
+            tmax = _mm_min_ps(tmax, _mm_load_ps(p.tMax + o));
+            mask |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(tmin, tmax)) << o;
+        }
+        return mask;
+#else
+        unsigned int mask = 0;
+        for (int lane = 0; lane < p.count; lane++) {
+            glm::vec3 origin(p.ox[lane], p.oy[lane], p.oz[lane]);
+            glm::vec3 invDir(p.ix[lane], p.iy[lane], p.iz[lane]);
+            if (TriangleBVH::EntryDistance(node, origin, invDir) <= p.tMax[lane]) mask |= 1u << lane;
+        }
+        return mask;
+#endif
+    }
+
+private:
+    void BuildRange(size_t begin, size_t end, int depth) {
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.push_back(BVHNode());
+        glm::vec3 bmin(1e30f), bmax(-1e30f), cmin(1e30f), cmax(-1e30f);
+        for (size_t i = begin; i < end; i++) {
+            bmin = glm::min(bmin, items[i].box.min);
+            bmax = glm::max(bmax, items[i].box.max);
+            glm::vec3 c = (items[i].box.min + items[i].box.max) * 0.5f;
+            cmin = glm::min(cmin, c);
+            cmax = glm::max(cmax, c);
+        }
+        nodes[index].bmin = bmin;
+        nodes[index].bmax = bmax;
+
+        if (end - begin <= MAX_LEAF_SIZE || depth >= BVH_MAX_DEPTH) {
+            nodes[index].offset = (uint32_t)begin;
+            nodes[index].count = (uint32_t)(end - begin);
+            return;
+        }
+
+        // median split along the widest centroid axis, cheap enough to rebuild whenever the item set changes
+        glm::vec3 extent = cmax - cmin;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end, [axis](const Item &a, const Item &b) {
+            return a.box.min[axis] + a.box.max[axis] < b.box.min[axis] + b.box.max[axis];
+        });
+
+        nodes[index].count = 0;
+        BuildRange(begin, mid, depth + 1);
+        nodes[index].offset = (uint32_t)nodes.size();
+        BuildRange(mid, end, depth + 1);
+    }
+
+    // Calls narrow(id, ray) for every leaf item whose box the ray reaches. narrow may shorten
+    // ray.tMax to prune the rest of the traversal and returns true to stop early.
+    template <typename F>
+    void Traverse(const Ray &ray, F narrow) const {
+        if (nodes.empty()) return;
+        Ray r = ray;
+        glm::vec3 invDir = 1.0f / ray.dir;
+        uint32_t stack[BVH_STACK_SIZE];
+        int sp = 0;
+        stack[sp++] = 0;
+        while (sp > 0) {
+            uint32_t nodeIndex = stack[--sp];
+            const BVHNode &node = nodes[nodeIndex];
+            if (!TriangleBVH::SlabTest(node, r.origin, invDir, r.tMax)) continue;
+            if (node.IsLeaf()) {
+                for (uint32_t o = node.offset; o < node.offset + node.count; o++)
+                    if (narrow(items[o].id, r)) return;
+            }
+            else {
+                stack[sp++] = node.offset;
+                stack[sp++] = nodeIndex + 1;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "GpuTimer.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "shader_m.h"
+
+// One draw: which mesh, with which material, at which transform. Packets hold no GL state, so any thread
+// can record them; only Replay talks to GL.
+struct DrawPacket {
+    uint64_t sortKey;
+    const Mesh *mesh;
+    uint32_t material;  // Mesh::MaterialKey
+    uint32_t transform; // index into the world / normal matrix arrays given to Replay
+};
+
+// Draw packets recorded in parallel, one bucket per recording job so no two threads share a vector. Sort
+// merges the buckets and orders them material first, then mesh, then front to back, so Replay binds each
+// material and vertex array once per run.
+class RenderQueue {
+public:
+    // Starts a frame with 'buckets' empty buckets. Bucket storage is kept between frames.
+    void Begin(size_t buckets) {
+        if (this->buckets.size() < buckets) this->buckets.resize(buckets);
+        used = buckets;
+        for (size_t i = 0; i < used; i++) this->buckets[i].clear();
+        packets.clear();
+    }
+
+    std::vector<DrawPacket> &Bucket(size_t i) { return buckets[i]; }
+
+    void Sort() {
+        size_t n = 0;
+        for (size_t i = 0; i < used; i++) n += buckets[i].size();
+        packets.reserve(n);
+        for (size_t i = 0; i < used; i++)
+            packets.insert(packets.end(), buckets[i].begin(), buckets[i].end());
+        std::sort(packets.begin(), packets.end(), [](const DrawPacket &a, const DrawPacket &b) { return a.sortKey < b.sortKey; });
+    }
+
+    const std::vector<DrawPacket> &Packets() const { return packets; }
+
+    // 16 bits material, 24 bits vertex array, 24 bits view distance.
+    static uint64_t SortKey(uint32_t material, uint32_t vertexArray, float distanceSq) {
+        const float MAX_DISTANCE_SQ = 1.0e4f;
+        float d = std::min(std::max(distanceSq / MAX_DISTANCE_SQ, 0.0f), 1.0f);
+        uint64_t depth = (uint64_t)(d * 0xFFFFFF);
+        return ((uint64_t)(material & 0xFFFF) << 48) | ((uint64_t)(vertexArray & 0xFFFFFF) << 24) | depth;
+    }
+
+    // GL thread only: issues the sorted packets. 'model' and 'normalMatrix' are set per packet from the arrays.
+    // 'timer', if given, brackets every draw.
+    void Replay(Shader &shader, const glm::mat4 *world, const glm::mat3 *normal, GpuTimer *timer = nullptr) const {
+        Replay(packets, shader, world, normal, timer);
+    }
+
+    static void Replay(const std::vector<DrawPacket> &packets, Shader &shader, const glm::mat4 *world, const glm::mat3 *normal,
+                       GpuTimer *timer = nullptr) {
+        PROFILE_ZONE("RenderQueue::Replay");
+        const Mesh *boundMaterial = nullptr;
+        GLuint boundVertexArray = 0;
+        for (const DrawPacket &p : packets) {
+            if (!boundMaterial || p.material != boundMaterial->MaterialKey() || !p.mesh->SameMaterial(*boundMaterial)) {
+                p.mesh->BindMaterial(shader);
+                boundMaterial = p.mesh;
+            }
+            if (p.mesh->vao.ID != boundVertexArray) {
+                p.mesh->vao.Bind();
+                boundVertexArray = p.mesh->vao.ID;
+            }
+            shader.setMat4("model", world[p.transform]);
+            shader.setMat3("normalMatrix", normal[p.transform]);
+            if (timer) timer->BeginDraw();
+            p.mesh->DrawElements();
+            if (timer) timer->EndDraw();
+        }
+        glBindVertexArray(0);
+    }
+
+private:
+    std::vector<std::vector<DrawPacket>> buckets;
+    size_t used = 0;
+    std::vector<DrawPacket> packets;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// What the renderer asked of GL in one frame. Counted where the calls are made (Mesh, VAO, Shader, the
+// texture and buffer uploads), so nothing can draw around them.
+enum RenderCounter {
+    RENDER_DRAW_CALLS,
+    RENDER_TRIANGLES,
+    RENDER_PROGRAM_BINDS,
+    RENDER_VAO_BINDS,
+    RENDER_TEXTURE_BINDS,
+    RENDER_UNIFORM_UPLOADS,
+    RENDER_BYTES_UPLOADED, // buffer and texture data
+    RENDER_CULLED,         // visible entities outside the frustum
+    RENDER_COUNTER_COUNT
+};
+
+const char *const RENDER_COUNTER_NAMES[RENDER_COUNTER_COUNT] = {
+    "draw calls", "triangles", "program binds", "vao binds", "texture binds", "uniform uploads", "bytes uploaded", "culled"
+};
+
+// The frame being drawn. GL thread only.
+uint64_t renderCounters[RENDER_COUNTER_COUNT];
+
+inline void CountRender(RenderCounter counter, uint64_t n = 1) { renderCounters[counter] += n; }
+
+struct CounterSummary {
+    uint64_t last = 0, min = 0, max = 0, p99 = 0;
+    double avg = 0.0;
+};
+
+// The counters of the last WINDOW frames, summarised on request, and optionally every frame as a CSV row
+class RenderStats {
+public:
+    static constexpr size_t WINDOW = 240;
+
+    RenderStats() {
+        for (auto &h : history) h.assign(WINDOW, 0);
+    }
+
+    void BeginFrame() { std::fill(renderCounters, renderCounters + RENDER_COUNTER_COUNT, 0); }
+
+    void EndFrame(uint64_t frame) {
+        for (int c = 0; c < RENDER_COUNTER_COUNT; c++) {
+            history[c][next] = renderCounters[c];
+            totals[c] += renderCounters[c];
+        }
+        runFrames++;
+        next = (next + 1) % WINDOW;
+        filled = std::min(filled + 1, WINDOW);
+        if (csv.is_open()) {
+            csv << frame;
+            for (int c = 0; c < RENDER_COUNTER_COUNT; c++) csv << "," << renderCounters[c];
+            csv << "\n";
+        }
+    }
+
+    size_t Frames() const { return filled; }
+
+    // Per frame over the whole run, not just the window
+    double RunAverage(RenderCounter counter) const { return runFrames ? (double)totals[counter] / runFrames : 0.0; }
+
+    CounterSummary Summary(RenderCounter counter) const {
+        CounterSummary s;
+        if (filled == 0) return s;
+        const std::vector<uint64_t> &h = history[counter];
+        std::vector<uint64_t> window(filled);
+        for (size_t i = 0; i < filled; i++) window[i] = h[(next + WINDOW - filled + i) % WINDOW];
+        s.last = window.back();
+        uint64_t sum = 0;
+        for (uint64_t v : window) sum += v;
+        s.avg = (double)sum / filled;
+        std::sort(window.begin(), window.end());
+        s.min = window.front();
+        s.max = window.back();
+        s.p99 = window[std::min(filled - 1, (size_t)(0.99 * (filled - 1) + 0.5))];
+        return s;
+    }
+
+    // From now on every frame is written as a row: frame number, then the counters
+    bool OpenCsv(const std::string &path) {
+        csv.open(path);
+        if (!csv) {
+            std::cout << "ERROR::RENDERSTATS::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        csv << "frame";
+        for (int c = 0; c < RENDER_COUNTER_COUNT; c++) csv << "," << RENDER_COUNTER_NAMES[c];
+        csv << "\n";
+        return true;
+    }
+
+    void Report() const {
+        std::cout << "Render stats over " << filled << " frames (min/avg/max/p99):";
+        for (int c = 0; c < RENDER_COUNTER_COUNT; c++) {
+            CounterSummary s = Summary((RenderCounter)c);
+            std::cout << "\n  " << RENDER_COUNTER_NAMES[c] << ": " << s.min << " / " << s.avg << " / " << s.max << " / " << s.p99;
+        }
+        std::cout << std::endl;
+    }
+
+private:
+    std::vector<uint64_t> history[RENDER_COUNTER_COUNT];
+    size_t next = 0, filled = 0;
+    uint64_t totals[RENDER_COUNTER_COUNT] = {};
+    uint64_t runFrames = 0;
+    std::ofstream csv;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef RUNMETRICS_H
+#define RUNMETRICS_H
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Peak resident memory of the process so far
+inline double PeakMemoryMb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0.0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0;            // kilobytes
+#endif
+#endif
+}
+
+// What one benchmark run measured, written by --metrics <file> as a flat JSON object for the benchmark
+// runner (Benchmarks/bench_runner.cpp), which repeats runs and compares them against a baseline
+struct RunMetrics {
+    size_t frames = 0, hitches = 0;
+    double frameMs = 0.0, frameMsP99 = 0.0; // median and 99th percentile frame time
+    double loadMs = 0.0;                    // process start to the first frame presented
+    double memoryMb = 0.0;                  // peak resident
+    double drawCalls = 0.0, triangles = 0.0; // per frame
+
+    bool Write(const std::string &path) const {
+        std::ofstream file(path);
+        file.precision(10);
+        file << "{\"frames\": " << frames << ", \"hitches\": " << hitches << ", \"frame_ms\": " << frameMs
+             << ", \"frame_ms_p99\": " << frameMsP99 << ", \"load_ms\": " << loadMs << ", \"memory_mb\": " << memoryMb
+             << ", \"draw_calls\": " << drawCalls << ", \"triangles\": " << triangles << "}\n";
+        if (!file) {
+            std::cout << "ERROR::METRICS::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+// Startup as a graph of init tasks on the job system. CPU tasks (model import, texture decode, BVH builds)
+// run on the workers as soon as their dependencies have finished; GL tasks (shaders, mesh buffers, texture
+// upload) are queued for whichever thread holds the context and runs them through Pump or RunUntil. Tasks
+// may add more tasks while they run, e.g. a model's upload adding the decode and upload of every texture
+// it uses.
+//
+// Loading only waits for what the first frame needs. The rest finishes behind it: the render thread pumps
+// the remaining uploads between frames, and until then meshes show their placeholder textures.
+struct StartupTask {
+    std::string name;
+    bool gl = false;
+    double start = 0.0, end = 0.0; // seconds since Start
+};
+
+class StartupGraph {
+public:
+    // Call on the thread that will hold the GL context while loading
+    void Start(JobSystem *jobs) {
+        this->jobs = jobs;
+        origin = std::chrono::steady_clock::now();
+        running = true;
+    }
+
+    // Call once Done, on the context thread. Textures of models loaded after this upload as they load, since
+    // nothing pumps GL tasks anymore.
+    void Stop() { running = false; }
+
+    bool Running() const { return running; }
+    bool Done() const { return pending == 0; }
+
+    double Elapsed() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count(); }
+
+    // A task that runs 'work' once every dependency has finished. The handle finishes with the task, so it
+    // can be a dependency itself, of tasks and of plain jobs.
+    JobHandle Add(const std::string &name, std::function<void()> work, std::initializer_list<JobHandle> dependencies = {},
+                  bool gl = false) {
+        StartupTask *task;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            tasks.push_back(StartupTask());
+            task = &tasks.back();
+        }
+        task->name = name;
+        task->gl = gl;
+        pending++;
+        JobHandle finished = jobs->Create(nullptr);
+        std::function<void()> run = [this, task, work, finished]() {
+            double start = Elapsed();
+            {
+                PROFILE_ZONE(task->name.c_str());
+                work();
+            }
+            task->start = start;
+            task->end = Elapsed();
+            jobs->Submit(finished);
+            pending--;
+        };
+        // A GL task is a job that hands it to the context thread; its handle is submitted once it has run
+        JobHandle job = jobs->Create(gl ? [this, run]() {
+            std::lock_guard<std::mutex> guard(glLock);
+            glTasks.push_back(run);
+        } : run);
+        for (auto &d : dependencies) jobs->DependsOn(job, d);
+        jobs->Submit(job);
+        return finished;
+    }
+
+    // A task that already ran on the calling thread, from 'start' until now
+    void Record(const std::string &name, double start, bool gl = true) {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(StartupTask());
+        tasks.back().name = name;
+        tasks.back().gl = gl;
+        tasks.back().start = start;
+        tasks.back().end = Elapsed();
+    }
+
+    // Context thread: runs up to 'limit' GL tasks of those that are ready. False when there were none.
+    bool Pump(size_t limit = SIZE_MAX) {
+        bool ran = false;
+        for (size_t n = 0; n < limit; n++) {
+            std::function<void()> run;
+            {
+                std::lock_guard<std::mutex> guard(glLock);
+                if (glTasks.empty()) return ran;
+                run = std::move(glTasks.front());
+                glTasks.pop_front();
+            }
+            run();
+            ran = true;
+        }
+        return ran;
+    }
+
+    // Context thread: runs GL tasks until every handle has finished
+    void RunUntil(std::initializer_list<JobHandle> handles) {
+        auto finished = [&]() {
+            for (auto &h : handles)
+                if (!h->done) return false;
+            return true;
+        };
+        while (!finished()) Step();
+    }
+
+    // Context thread: the same until no task is left
+    void Finish() {
+        while (!Done()) Step();
+    }
+
+    // Every task by start time, then the total work against the wall time it took. Call once Done.
+    void Report() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<const StartupTask*> order;
+        for (auto &t : tasks) order.push_back(&t);
+        std::sort(order.begin(), order.end(), [](const StartupTask *a, const StartupTask *b) { return a->start < b->start; });
+        double work = 0.0, wall = 0.0;
+        std::cout << "Startup tasks (ms):" << std::endl;
+        for (const StartupTask *t : order) {
+            char line[200];
+            std::snprintf(line, sizeof(line), "  %-48s %-3s start %8.1f  took %8.1f", t->name.c_str(), t->gl ? "gl" : "cpu",
+                          t->start * 1000.0, (t->end - t->start) * 1000.0);
+            std::cout << line << std::endl;
+            work += t->end - t->start;
+            wall = std::max(wall, t->end);
+        }
+        std::cout << "Startup: " << tasks.size() << " tasks, " << work * 1000.0 << " ms of work in " << wall * 1000.0
+                  << " ms" << std::endl;
+    }
+
+private:
+    // A GL task if one is ready. CPU tasks only when there are no workers to run them: a decode picked up
+    // here would hold back the GL tasks that become ready meanwhile.
+    void Step() {
+        if (Pump(1)) return;
+        if (jobs->WorkerCount() > 1 || !jobs->RunOne()) std::this_thread::yield();
+    }
+
+    JobSystem *jobs = nullptr;
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<bool> running{ false };
+    std::atomic<int> pending{ 0 };
+    std::mutex lock;
+    std::deque<StartupTask> tasks; // guarded by lock; a deque, so tasks never move
+    std::mutex glLock;
+    std::deque<std::function<void()>> glTasks;
+};
+
+StartupGraph startup;
+
+#endif
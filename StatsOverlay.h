@@ -0,0 +1,132 @@
+#ifndef STATSOVERLAY_H
+#define STATSOVERLAY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shader_m.h"
+#include "RenderStats.h"
+
+// The render stats drawn in the top left corner of the frame: the text is rasterised on the CPU with a 3x5
+// pixel font into a one-channel texture, then drawn as a single quad. GL thread only.
+class StatsOverlay {
+public:
+    static const int SCALE = 2; // screen pixels per font pixel
+
+    // Needs a current context
+    void Init() {
+        shader.reset(new Shader("./Overlay.vs", "./Overlay.fs"));
+        glGenVertexArrays(1, &vertexArray);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // Re-renders the text from the current window of 'stats'
+    void Update(const RenderStats &stats) {
+        std::vector<std::string> lines;
+        char line[128];
+        std::snprintf(line, sizeof(line), "%-16s%10s%10s%10s%10s%10s", "RENDER STATS", "LAST", "MIN", "AVG", "MAX", "P99");
+        lines.push_back(line);
+        for (int c = 0; c < RENDER_COUNTER_COUNT; c++) {
+            CounterSummary s = stats.Summary((RenderCounter)c);
+            std::snprintf(line, sizeof(line), "%-16s%10llu%10llu%10.1f%10llu%10llu", RENDER_COUNTER_NAMES[c],
+                          (unsigned long long)s.last, (unsigned long long)s.min, s.avg, (unsigned long long)s.max,
+                          (unsigned long long)s.p99);
+            lines.push_back(line);
+        }
+
+        size_t columns = 0;
+        for (const std::string &l : lines) columns = std::max(columns, l.size());
+        width = (int)columns * 4 + 1;
+        height = (int)lines.size() * 6 + 1;
+        std::vector<unsigned char> pixels(width * height, 0);
+        for (size_t row = 0; row < lines.size(); row++)
+            for (size_t col = 0; col < lines[row].size(); col++) {
+                const char *glyph = Glyph(lines[row][col]);
+                for (int y = 0; y < 5; y++)
+                    for (int x = 0; x < 3; x++)
+                        if (glyph[y * 3 + x] == '1') pixels[(row * 6 + y + 1) * width + col * 4 + x + 1] = 255;
+            }
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // Over whatever was drawn, on a viewport of the given size
+    void Draw(int viewportWidth, int viewportHeight) {
+        if (width == 0 || viewportWidth == 0 || viewportHeight == 0) return;
+        GLboolean depth = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        float right = -1.0f + 2.0f * width * SCALE / viewportWidth;
+        float bottom = 1.0f - 2.0f * height * SCALE / viewportHeight;
+        shader->use();
+        shader->setVec4("rect", glm::vec4(-1.0f, bottom, right, 1.0f));
+        shader->setInt("glyphs", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glBindVertexArray(vertexArray);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if (depth) glEnable(GL_DEPTH_TEST);
+        if (!blend) glDisable(GL_BLEND);
+    }
+
+    void Release() {
+        if (!shader) return;
+        glDeleteProgram(shader->ID);
+        glDeleteVertexArrays(1, &vertexArray);
+        glDeleteTextures(1, &texture);
+        shader.reset();
+    }
+
+private:
+    std::unique_ptr<Shader> shader;
+    GLuint vertexArray = 0, texture = 0;
+    int width = 0, height = 0;
+
+    // Five rows of three pixels. Lower case is drawn as upper case; anything unknown is blank.
+    static const char *Glyph(char c) {
+        if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+        static const char *const digits[10] = {
+            "111101101101111", "010110010010111", "111001111100111", "111001111001111", "101101111001001",
+            "111100111001111", "111100111101111", "111001001001001", "111101111101111", "111101111001111"
+        };
+        static const char *const letters[26] = {
+            "010101111101101", "110101110101110", "011100100100011", "110101101101110", "111100110100111",
+            "111100110100100", "011100101101011", "101101111101101", "111010010010111", "001001001101010",
+            "101101110101101", "100100100100111", "101111111101101", "110101101101101", "010101101101010",
+            "110101110100100", "010101101110011", "110101110101101", "011100010001110", "111010010010010",
+            "101101101101111", "101101101101010", "101101111111101", "101101010101101", "101101010010010",
+            "111001010100111"
+        };
+        if (c >= '0' && c <= '9') return digits[c - '0'];
+        if (c >= 'A' && c <= 'Z') return letters[c - 'A'];
+        switch (c) {
+        case '.': return "000000000000010";
+        case ':': return "000010000010000";
+        case '/': return "001001010100100";
+        case '-': return "000000111000000";
+        default:  return "000000000000000";
+        }
+    }
+};
+
+#endif
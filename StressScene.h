@@ -0,0 +1,159 @@
+#ifndef STRESSSCENE_H
+#define STRESSSCENE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "EntityStore.h"
+#include "FrameTimes.h"
+
+// Generated arenas for scaling benchmarks: N crates in a grid or in random clusters, split into moving
+// (spinning and bobbing), static (blocks that never move or break) and destructible (crates that sit still
+// until hit) in the given ratios. Every run can append one CSV row of frame time and per-subsystem cost, so
+// a sweep over N plots where each system stops scaling.
+struct StressConfig {
+    size_t crates = 0;      // 0: the hand-made level
+    bool clusters = false;  // random clusters instead of a grid
+    float moving = 1.0f, fixed = 0.0f, destructible = 0.0f; // ratios, need not add up to 1
+    uint32_t seed = 1;
+    std::string csvPath;
+};
+
+struct StressCounts {
+    size_t moving = 0, fixed = 0, destructible = 0;
+};
+
+const float STRESS_SPACING = 2.5f; // grid pitch; also sets the clusters' density
+
+// Creates the crates with their near face at z = 'front', centred on x = y = 0. The mix is exact up to
+// rounding and shuffled, so no kind is bunched on one side.
+StressCounts BuildStressScene(EntityStore &store, Model *crate, const StressConfig &config, float front) {
+    StressCounts counts;
+    size_t n = config.crates;
+    float moving = config.moving, total = config.moving + config.fixed + config.destructible;
+    if (total <= 0.0f) total = moving = 1.0f;
+    counts.moving = (size_t)std::lround(n * (double)moving / total);
+    counts.fixed = std::min(n - counts.moving, (size_t)std::lround(n * (double)config.fixed / total));
+    counts.destructible = n - counts.moving - counts.fixed;
+
+    enum { MOVING, FIXED, DESTRUCTIBLE };
+    std::vector<uint8_t> kinds(n, DESTRUCTIBLE);
+    std::fill(kinds.begin(), kinds.begin() + counts.moving, MOVING);
+    std::fill(kinds.begin() + counts.moving, kinds.begin() + counts.moving + counts.fixed, FIXED);
+    std::mt19937 rng(config.seed);
+    std::shuffle(kinds.begin(), kinds.end(), rng);
+
+    // A cube of side cbrt(n) crates, or n / 1000 clusters (1 to 256) scattered through the same cube, packed
+    // tighter than the grid
+    int side = std::max(1, (int)std::ceil(std::cbrt((double)n)));
+    float half = 0.5f * STRESS_SPACING * (side - 1);
+    glm::vec3 center(0.0f, 0.0f, front - half);
+    std::vector<glm::vec3> centers;
+    float sigma = 0.0f;
+    if (config.clusters) {
+        size_t k = std::min<size_t>(256, std::max<size_t>(1, n / 1000));
+        std::uniform_real_distribution<float> inside(-half, half);
+        for (size_t c = 0; c < k; c++) centers.push_back(center + glm::vec3(inside(rng), inside(rng), inside(rng)));
+        sigma = 0.25f * STRESS_SPACING * (float)std::cbrt((double)n / k);
+    }
+    std::normal_distribution<float> around(0.0f, 1.0f);
+
+    const glm::vec3 scale(0.6f);
+    for (size_t i = 0; i < n; i++) {
+        glm::vec3 pos;
+        if (config.clusters)
+            pos = centers[i % centers.size()] + sigma * glm::vec3(around(rng), around(rng), around(rng));
+        else
+            pos = center + STRESS_SPACING * glm::vec3((float)(i % side), (float)(i / side % side), (float)(i / side / side)) - glm::vec3(half);
+        if (kinds[i] == FIXED)
+            store.Create("block", KIND_STATIC, crate, pos, 0.0f, scale);
+        else {
+            Entity e = store.Create("box", KIND_CRATE, crate, pos, 0.0f, scale);
+            if (kinds[i] == MOVING) store.AddIdle(e);
+        }
+    }
+    return counts;
+}
+
+// CPU time per subsystem, summed over every thread that ran part of it, so a system split across the job
+// workers costs what all its chunks cost together
+enum Subsystem {
+    SUB_IDLE,
+    SUB_PROJECTILES,
+    SUB_BOUNDS,
+    SUB_COLLISIONS,
+    SUB_CULL,
+    SUB_AIM,        // scene query refit or rebuild and the camera ray
+    SUB_RECORD,
+    SUB_TRANSFORMS,
+    SUB_SORT,
+    SUB_SNAPSHOT,
+    SUB_RENDER,     // render thread: state, uniforms and draw submission
+    SUB_COUNT
+};
+
+const char *const SUBSYSTEM_NAMES[SUB_COUNT] = {
+    "idle", "projectiles", "bounds", "collisions", "cull", "aim", "record_draws", "transforms", "sort", "snapshot", "render"
+};
+
+bool subsystemTiming = false; // set before the threads start
+std::atomic<uint64_t> subsystemNs[SUB_COUNT];
+std::atomic<uint64_t> subsystemFrames{ 0 };
+
+class SubsystemTimer {
+public:
+    explicit SubsystemTimer(Subsystem subsystem) : subsystem(subsystem) {
+        if (subsystemTiming) start = std::chrono::steady_clock::now();
+    }
+    ~SubsystemTimer() { Stop(); }
+
+    // Ends the measurement before the scope does
+    void Stop() {
+        if (!subsystemTiming || stopped) return;
+        stopped = true;
+        subsystemNs[subsystem] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    SubsystemTimer(const SubsystemTimer&) = delete;
+    SubsystemTimer &operator=(const SubsystemTimer&) = delete;
+
+private:
+    Subsystem subsystem;
+    bool stopped = false;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Appends this run to the CSV, with a header when the file is new: the scene, frame time percentiles, then
+// each subsystem's milliseconds per simulated frame
+bool WriteStressRow(const StressConfig &config, const StressCounts &counts, size_t projectiles, size_t entities,
+                    const FrameTimes &frameTimes) {
+    bool header = !std::ifstream(config.csvPath).good();
+    std::ofstream file(config.csvPath, std::ios::app);
+    if (!file) {
+        std::cout << "ERROR::STRESS::CANNOT_WRITE " << config.csvPath << std::endl;
+        return false;
+    }
+    if (header) {
+        file << "crates,layout,moving,static,destructible,projectiles,entities,frames,frame_ms_mean,frame_ms_p50,frame_ms_p99";
+        for (int s = 0; s < SUB_COUNT; s++) file << "," << SUBSYSTEM_NAMES[s] << "_ms";
+        file << "\n";
+    }
+    uint64_t frames = std::max<uint64_t>(1, subsystemFrames.load());
+    file << config.crates << "," << (config.clusters ? "clusters" : "grid") << "," << counts.moving << "," << counts.fixed
+         << "," << counts.destructible << "," << projectiles << "," << entities << "," << frameTimes.Count() << ","
+         << frameTimes.Mean() * 1000.0 << "," << frameTimes.Percentile(0.5) * 1000.0 << "," << frameTimes.Percentile(0.99) * 1000.0;
+    for (int s = 0; s < SUB_COUNT; s++) file << "," << subsystemNs[s].load() / 1.0e6 / frames;
+    file << "\n";
+    return (bool)file;
+}
+
+#endif
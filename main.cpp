@@ -8,13 +8,44 @@
 #include "shader_m.h"
 #include "Camera.h"
 #include "Objects.h"
+#include "Raycast.h"
+#include "DistanceField.h"
+#include "FixedTimestep.h"
+#include "EntityStore.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+#include "FramePipeline.h"
+#include "InputQueue.h"
+#include "Headless.h"
+#include "GoldenImage.h"
+#include "InputRecording.h"
+#include "Flythrough.h"
+#include "FrameTimes.h"
+#include "Profiler.h"
+#include "GpuTimer.h"
+#include "RenderStats.h"
+#include "StatsOverlay.h"
+#include "StressScene.h"
+#include "RunMetrics.h"
+#include "Startup.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(double now, float frameTime);
 
 // Settings
 const unsigned int SCR_WIDTH = 800;
@@ -27,10 +58,91 @@ float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
 // Timing
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
 float initTime = 0.0f;
-float currTime = 0.0f;
+float simRate = 60.0f;
+FixedTimestep simClock;
+
+// Jobs: per-frame update, bounds, collision and culling run on the pool, GL stays on the render thread
+std::unique_ptr<JobSystem> jobs;
+unsigned int jobThreads = 0;
+const size_t JOB_GRAIN = 4096; // entities per parallel-for chunk
+
+// Threads: the main thread pumps window events, the simulation thread owns the world and the camera, the
+// render thread owns the GL context and draws the frames the simulation hands it
+std::unique_ptr<FramePipeline> pipeline;
+size_t pipelineDepth = 1;
+std::string aimTitle = "LearnOpenGL";
+std::vector<uint32_t> snapshotIndex;
+std::mutex titleLock;
+std::string windowTitle = "LearnOpenGL"; // set by the render thread, applied by the main thread
+std::atomic<int> framebufferWidth{ (int)SCR_WIDTH }, framebufferHeight{ (int)SCR_HEIGHT };
+
+// Input: GLFW callbacks stamp each event with Now() and queue it for the simulation thread, which
+// applies it at the simulation time it happened
+SpscQueue<InputEvent, 4096> inputQueue;
+std::atomic<unsigned int> droppedInput{ 0 };
+bool keyDown[GLFW_KEY_LAST + 1];
+struct PendingLaunch {
+    float time;      // simulation time of the key press
+    glm::vec3 front; // view direction at that moment
+    bool volley;
+};
+std::vector<PendingLaunch> pendingLaunches;
+
+// Headless: --headless <frames> renders that many frames into an offscreen target through EGL or OSMesa
+// instead of a window, one simulation step per frame so every run draws the same images. The last frame can
+// be saved (--capture) or checked against a reference image (--golden).
+bool headless = false;
+uint64_t headlessFrames = 0; // 0: until the replay or flythrough ends
+HeadlessContext headlessContext;
+std::string capturePath, goldenPath;
+int goldenTolerance = 2;       // per channel
+double goldenAllowed = 0.001;  // fraction of pixels
+int exitStatus = 0;
+
+// Benchmark runs: --record <file> saves the input as the simulation consumed it, --replay <file> plays it
+// back, --flythrough <file> moves the camera along a scripted spline. Replays, flythroughs and headless runs
+// use a fixed clock instead of the wall clock, end with the recording or the path, and report frame times.
+std::string recordPath;
+InputRecorder recorder;
+bool replaying = false;
+InputPlayer player;
+bool flying = false;
+Flythrough flythrough;
+bool fixedClock = false;
+std::atomic<bool> runFinished{ false };
+
+// Profiling (builds with -DPROFILER_ENABLED): --profile <file> captures from startup, P starts and stops a
+// capture at runtime. Each capture is written to the file as a Chrome trace when it stops.
+// P only queues the toggle: the simulation thread starts and stops the capture between frames and writes
+// the trace a frame after stopping, once zones still open on other threads have been recorded.
+std::string profilePath = "profile.json";
+std::atomic<bool> profilerToggle{ false };
+bool profileExportPending = false; // simulation thread, then main after the joins
+
+// GPU timing: --gpu-timers measures each render pass with timer and pipeline statistics queries,
+// --gpu-timers-per-draw every draw call as well
+bool gpuTimers = false;
+GpuTimer gpuTimer;
+
+// Render stats: draw calls, binds, uploads and the like, counted every frame. O (or --stats-overlay) shows
+// them over the last few seconds on screen, --render-stats-csv <file> writes every frame's counters.
+RenderStats renderStats;
+std::atomic<bool> showStats{ false };
+std::string statsCsvPath;
+
+// Stress scenes: --stress <crates> replaces the level's crates with a generated arena (--stress-layout
+// grid|clusters, --stress-mix moving:static:destructible, --stress-seed <n>); the --projectiles volley
+// then fires by itself, so that many balls are always in flight. --stress-csv <file> appends the run's frame
+// time and per-subsystem cost, one row per run.
+StressConfig stress;
+StressCounts stressCounts;
+FrameTimes frameTimes; // render thread, read once it has joined
+
+// Benchmark runner support: --metrics <file> writes the run's frame times, load time, peak memory and draw
+// calls, for Benchmarks/bench_runner.cpp to repeat and compare against a baseline
+std::string metricsPath;
+double firstFrameTime = 0.0; // Now() when the first frame was presented
 
 // Lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
@@ -38,42 +150,162 @@ GLuint luna_vao;
 int luna_numIndices;
 
 // Objets
-std::vector<Object*> vObj;
+// Everything owned by the current level comes from its arena and is freed together on unload
+Arena levelArena;
+EntityStore store(levelArena);
+SceneQuery sceneQuery;
+DistanceField arenaField;
+RenderQueue renderQueue;
+Entity AimTarget = NO_ENTITY;
+Entity CollidedEntity = NO_ENTITY;
 
 // Ball
-Model mball(glm::vec3(0.0f, -5.0f, 15.0f), 0.0, glm::vec3(0.1f, 0.1f, 0.1f), "./Models/Ball/ball.obj", "ball");   
+const glm::vec3 BALL_START(0.0f, -5.0f, 15.0f);
+const glm::vec3 BALL_SCALE(0.1f, 0.1f, 0.1f);
+Model mball("./Models/Ball/ball.obj");
+Entity ball = NO_ENTITY;
+
+// Mass projectile mode: --projectiles <n> adds n more balls, fired together with F
+size_t volleySize = 0;
+std::vector<Entity> volley;
+BoundsStore volleyTargets;              // crates and the static blocks outside the arena field
+std::vector<Entity> volleyTargetIds;
+std::vector<uint8_t> volleyTargetBreaks; // crates break, blocks only stop the ball
+std::mt19937 volleyRng(1);
 
-int main() {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+void BallCollisions();
+void ResetBall();
+void LaunchVolley(const glm::vec3 &front, float time);
+void VolleyCollisions();
+JobHandle ScheduleStep(float time, float dt);
+void SimulationLoop();
+void RenderLoop(GLFWwindow *window, Shader *shader);
+void FireLaunches(float until);
+double Now();
+void CheckHeadlessFrame(const OffscreenTarget &target);
+void ReportGpuTimes();
+bool NextInput(double now, InputEvent &ev);
+
+int main(int argc, char** argv) {
+    Now(); // starts the clock: load time counts from here
+    // Command line: --sim-hz <rate> sets the simulation rate, --projectiles <n> the volley size,
+    // --threads <n> the job workers (default one per hardware thread), --pipeline-depth <0-2> how many frames
+    // the simulation may run ahead of rendering (0 hands over one frame at a time, no overlap),
+    // --headless <frames> [--capture <ppm>] [--golden <ppm>] [--golden-tolerance <n>] runs without a window,
+    // --record <file>, --replay <file> and --flythrough <file> record or script a benchmark run,
+    // --profile <file> captures a CPU profile, --gpu-timers [--gpu-timers-per-draw] times the GPU,
+    // --stats-overlay shows the render stats, --render-stats-csv <file> saves them per frame,
+    // --stress <crates> [--stress-layout ...] [--stress-mix ...] [--stress-csv <file>] generates a stress scene,
+    // --metrics <file> saves the run's numbers for the benchmark runner
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc)
+            simRate = static_cast<float>(std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--projectiles") == 0 && i + 1 < argc)
+            volleySize = static_cast<size_t>(std::atol(argv[++i]));
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            jobThreads = static_cast<unsigned int>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--pipeline-depth") == 0 && i + 1 < argc)
+            pipelineDepth = std::min<size_t>(2, static_cast<size_t>(std::atoi(argv[++i])));
+        else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headless = true;
+            headlessFrames = static_cast<uint64_t>(std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            goldenPath = argv[++i];
+        else if (std::strcmp(argv[i], "--golden-tolerance") == 0 && i + 1 < argc)
+            goldenTolerance = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            if (!player.Load(argv[++i])) return -1;
+            replaying = true;
+        }
+        else if (std::strcmp(argv[i], "--flythrough") == 0 && i + 1 < argc) {
+            if (!flythrough.Load(argv[++i])) return -1;
+            flying = true;
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profilePath = argv[++i];
+            if (Profiler::Available) Profiler::Start();
+            else std::cout << "ERROR::PROFILER::NOT_BUILT (build with -DPROFILER_ENABLED)" << std::endl;
+        }
+        else if (std::strcmp(argv[i], "--stats-overlay") == 0)
+            showStats = true;
+        else if (std::strcmp(argv[i], "--render-stats-csv") == 0 && i + 1 < argc)
+            statsCsvPath = argv[++i];
+        else if (std::strcmp(argv[i], "--stress") == 0 && i + 1 < argc)
+            stress.crates = static_cast<size_t>(std::atol(argv[++i]));
+        else if (std::strcmp(argv[i], "--stress-layout") == 0 && i + 1 < argc)
+            stress.clusters = std::strcmp(argv[++i], "clusters") == 0;
+        else if (std::strcmp(argv[i], "--stress-mix") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%f:%f:%f", &stress.moving, &stress.fixed, &stress.destructible) != 3) {
+                std::cout << "ERROR::STRESS::MIX expected moving:static:destructible, got " << argv[i] << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--stress-seed") == 0 && i + 1 < argc)
+            stress.seed = static_cast<uint32_t>(std::atol(argv[++i]));
+        else if (std::strcmp(argv[i], "--stress-csv") == 0 && i + 1 < argc)
+            stress.csvPath = argv[++i];
+        else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+            metricsPath = argv[++i];
+        else if (std::strcmp(argv[i], "--gpu-timers") == 0)
+            gpuTimers = true;
+        else if (std::strcmp(argv[i], "--gpu-timers-per-draw") == 0)
+            gpuTimers = gpuTimer.perDraw = true;
+    }
+    PROFILE_THREAD("Main");
+    // A replay only repeats the run at the rate it was recorded at
+    if (replaying) simRate = player.simRate;
+    if (headless && headlessFrames == 0 && !replaying && !flying) headlessFrames = 1;
+    fixedClock = headless || replaying || flying;
+    jobs.reset(new JobSystem(jobThreads));
+    if (simRate <= 0.0f) simRate = 60.0f;
+    simClock.SetRate(simRate);
+    startup.Start(jobs.get());
+
+    GLFWwindow* window = NULL;
+    if (headless) {
+        // No window system: a surfaceless / off-screen context, current on this thread while loading
+        if (!headlessContext.Create(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
+    }
+    else {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
 
-    // Tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // Tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    GLADloadproc loader = headless ? (GLADloadproc)HeadlessContext::ProcAddress : (GLADloadproc)glfwGetProcAddress;
+    if (!gladLoadGLLoader(loader)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
@@ -84,205 +316,751 @@ int main() {
     // Configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
-
-    // Build and compile our shader zprogram
-    // ------------------------------------
-    Shader lightingShader("./VertexShader.vs", "./FragmentShader.fs");
+    startup.Record("context", 0.0);
 
     // Sphere For Testing
     //Sphere s1(glm::vec3(0.0f, 0.0f, 0.0f), 0.0, glm::vec3(1.0f, 1.0f, 1.0f), 4.0f, 100, 100);
     //s1.pos_ini = glm::vec3(0.0f,0.0f,0.0f); s1.vel_ini = glm::vec3(10,10,10); s1.ang_ini = 45.0f;
     //s1.Setup();
-    //vObj.emplace_back(&s1);
+
+    // Shaders and assets through the startup graph: shader compilation and buffer uploads on this thread,
+    // which holds the context; imports, texture decodes and BVH builds on the job workers, so the models
+    // import side by side. Loading waits for the shaders and geometry; textures keep loading behind the
+    // first frames.
+    std::unique_ptr<Shader> lightingShader;
+    Model mbox("./Models/Box/box.obj");
+    Model mfloor("./Models/Floor/floor.obj");
+    Model mWall("./Models/Wall/wall.obj");
+    JobHandle shaders = startup.Add("shaders", [&]() {
+        lightingShader.reset(new Shader("./VertexShader.vs", "./FragmentShader.fs"));
+    }, {}, true);
+    JobHandle boxImport = startup.Add("import box.obj", [&]() { mbox.Import(); });
+    JobHandle boxUpload = startup.Add("buffers box.obj", [&]() { mbox.Upload(); }, { boxImport }, true);
+    JobHandle ballImport = startup.Add("import ball.obj", [&]() { mball.Import(); });
+    JobHandle ballUpload = startup.Add("buffers ball.obj", [&]() { mball.Upload(); }, { ballImport }, true);
+    JobHandle floorImport = startup.Add("import floor.obj", [&]() { mfloor.Import(); });
+    JobHandle floorUpload = startup.Add("buffers floor.obj", [&]() { mfloor.Upload(); }, { floorImport }, true);
+    JobHandle floorBVH = startup.Add("bvh floor.obj", [&]() { mfloor.BuildBVH(jobs.get()); }, { floorUpload });
+    JobHandle wallImport = startup.Add("import wall.obj", [&]() { mWall.Import(); });
+    JobHandle wallUpload = startup.Add("buffers wall.obj", [&]() { mWall.Upload(); }, { wallImport }, true);
+    JobHandle wallBVH = startup.Add("bvh wall.obj", [&]() { mWall.BuildBVH(jobs.get()); }, { wallUpload });
+    startup.RunUntil({ shaders, boxUpload, ballUpload, floorBVH, wallBVH });
+
+    store.Reserve(32 + volleySize + stress.crates);
+    store.ReserveProjectiles(1 + volleySize);
 
     // Level 1 Boxes
-    Model mbox(glm::vec3(0.0f, 0.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    mbox.Setup();
-    vObj.emplace_back(&mbox);
-    Model mbox1(glm::vec3(-5.0f, 0.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox1.Setup();
-    mbox1.m = mbox.m;
-    mbox1.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox1);
-    Model mbox2(glm::vec3(5.0f, 0.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox2.Setup();
-    mbox2.m = mbox.m;
-    mbox2.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox2);
-    Model mbox3(glm::vec3(0.0f, 5.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox3.Setup();
-    mbox3.m = mbox.m;
-    mbox3.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox3);
-    Model mbox4(glm::vec3(0.0f, -5.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox4.Setup();
-    mbox4.m = mbox.m;
-    mbox4.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox4);
-    Model mbox5(glm::vec3(5.0f, -5.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox5.Setup();
-    mbox5.m = mbox.m;
-    mbox5.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox5);
-    Model mbox6(glm::vec3(-5.0f, -5.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox6.Setup();
-    mbox6.m = mbox.m;
-    mbox6.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox6);
-    Model mbox7(glm::vec3(5.0f, 5.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox7.Setup();
-    mbox7.m = mbox.m;
-    mbox7.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox7);
-    Model mbox8(glm::vec3(-5.0f, 5.0f, -7.0f), 0.0, glm::vec3(0.6f, 0.6f, 0.6f), "./Models/Box/box.obj", "box");
-    //mbox8.Setup();
-    mbox8.m = mbox.m;
-    mbox8.textures_loaded = mbox.textures_loaded;
-    vObj.emplace_back(&mbox8);
-        
-    // Setup Ball
-    mball.Setup();
+    const glm::vec3 boxScale(0.6f, 0.6f, 0.6f);
+    const glm::vec3 boxes[] = {
+        glm::vec3( 0.0f,  0.0f, -7.0f), glm::vec3(-5.0f,  0.0f, -7.0f), glm::vec3( 5.0f,  0.0f, -7.0f),
+        glm::vec3( 0.0f,  5.0f, -7.0f), glm::vec3( 0.0f, -5.0f, -7.0f), glm::vec3( 5.0f, -5.0f, -7.0f),
+        glm::vec3(-5.0f, -5.0f, -7.0f), glm::vec3( 5.0f,  5.0f, -7.0f), glm::vec3(-5.0f,  5.0f, -7.0f)
+    };
+    if (stress.crates == 0)
+        for (auto &p : boxes)
+            store.AddIdle(store.Create("box", KIND_CRATE, &mbox, p, 0.0f, boxScale));
+
+    // Ball
+    ball = store.Create("ball", KIND_PROJECTILE, &mball, BALL_START, 0.0f, BALL_SCALE);
+    store.SetSphereBounds(ball, RAD_FOR_BOUNDS);
+    store.AddProjectile(ball);
+
+    // Volley, hidden until fired
+    volley.reserve(volleySize);
+    for (size_t i = 0; i < volleySize; i++) {
+        Entity e = store.Create("volley", KIND_PROJECTILE, &mball, BALL_START, 0.0f, BALL_SCALE);
+        store.SetSphereBounds(e, RAD_FOR_BOUNDS);
+        store.AddProjectile(e);
+        store.SetVisible(e, false);
+        volley.push_back(e);
+    }
 
     // Background
-    Model mfloor(glm::vec3(0.0, -7.0f, 0.0f), 0.0, glm::vec3(7.0f, 7.0f, 7.0f), "./Models/Floor/floor.obj", "floor");
-    mfloor.Setup();
-    vObj.emplace_back(&mfloor);
-
-    Model mWall(glm::vec3(0.0f,-6.0f,-15.0f), 0.0f, glm::vec3(0.1f,0.1f,0.1f), "./Models/Wall/wall.obj", "wall");
-    mWall.Setup();
-    vObj.emplace_back(&mWall);
-    Model mWall1(glm::vec3(-13.0f, -6.0f, -7.0f), 90.0, glm::vec3(0.1f,0.1f,0.1f), "./Models/Box/box.obj", "wall");
-    //mWall1.Setup();
-    mWall1.m = mWall.m;
-    mWall1.textures_loaded = mWall.textures_loaded;
-    vObj.emplace_back(&mWall1);
-    Model mWall2(glm::vec3(13.0f, -6.0f, -7.0f), -90.0, glm::vec3(0.1f,0.1f,0.1f), "./Models/Box/box.obj", "wall");
-    //mWall2.Setup();
-    mWall2.m = mWall.m;
-    mWall2.textures_loaded = mWall.textures_loaded;
-    vObj.emplace_back(&mWall2);
-    Model mWall3(glm::vec3(13.0f, -6.0f, 10.0f), -90.0, glm::vec3(0.1f,0.1f,0.1f), "./Models/Box/box.obj", "wall");
-    //mWall3.Setup();
-    mWall3.m = mWall.m;
-    mWall3.textures_loaded = mWall.textures_loaded;
-    vObj.emplace_back(&mWall3);
-    Model mWall4(glm::vec3(-13.0f, -6.0f, 10.0f), 90.0, glm::vec3(0.1f,0.1f,0.1f), "./Models/Box/box.obj", "wall");
-    //mWall4.Setup();
-    mWall4.m = mWall.m;
-    mWall4.textures_loaded = mWall.textures_loaded;
-    vObj.emplace_back(&mWall4);
-    Model mWall5(glm::vec3(0.0f, -6.0f, 22.0f), 180.0, glm::vec3(0.1f,0.1f,0.1f), "./Models/Box/box.obj", "wall");
-    //mWall5.Setup();
-    mWall5.m = mWall.m;
-    mWall5.textures_loaded = mWall.textures_loaded;
-    vObj.emplace_back(&mWall5);
-    
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Per-frame time logic
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-        currTime = currentFrame - initTime;
-
-        processInput(window);
+    store.Create("floor", KIND_STATIC, &mfloor, glm::vec3(0.0, -7.0f, 0.0f), 0.0f, glm::vec3(7.0f, 7.0f, 7.0f));
+    const glm::vec3 wallScale(0.1f, 0.1f, 0.1f);
+    store.Create("wall", KIND_STATIC, &mWall, glm::vec3(  0.0f, -6.0f, -15.0f),   0.0f, wallScale);
+    store.Create("wall", KIND_STATIC, &mWall, glm::vec3(-13.0f, -6.0f,  -7.0f),  90.0f, wallScale);
+    store.Create("wall", KIND_STATIC, &mWall, glm::vec3( 13.0f, -6.0f,  -7.0f), -90.0f, wallScale);
+    store.Create("wall", KIND_STATIC, &mWall, glm::vec3( 13.0f, -6.0f,  10.0f), -90.0f, wallScale);
+    store.Create("wall", KIND_STATIC, &mWall, glm::vec3(-13.0f, -6.0f,  10.0f),  90.0f, wallScale);
+    store.Create("wall", KIND_STATIC, &mWall, glm::vec3(  0.0f, -6.0f,  22.0f), 180.0f, wallScale);
+
+    // Bake the static room into a distance field so ball vs arena is a single lookup
+    std::vector<SDFSource> arena;
+    for (size_t r = 0; r < store.Size(); r++) {
+        if (store.kind[r] != KIND_STATIC) continue;
+        DistanceField::AddSource(arena, *store.render.asset[r], store.ModelMatrixAt(r), store.transform.sx[r]);
+        store.inDistanceField[r] = 1;
+    }
+    {
+        PROFILE_ZONE("DistanceField::BuildCached");
+        double bakeStart = startup.Elapsed();
+        arenaField.BuildCached(arena, "./Models/arena.sdf", jobs.get());
+        startup.Record("distance field", bakeStart, false);
+    }
+
+    // Generated after the bake: its static blocks are not part of the room's distance field
+    if (stress.crates > 0) {
+        stressCounts = BuildStressScene(store, &mbox, stress, -7.0f);
+        std::cout << "Stress scene: " << stressCounts.moving << " moving, " << stressCounts.fixed << " static, "
+                  << stressCounts.destructible << " destructible, " << volleySize << " projectiles" << std::endl;
+    }
+    subsystemTiming = !stress.csvPath.empty();
+    size_t entities = store.Size();
+
+    // The simulation and the renderer run on their own threads. This one keeps the window, since GLFW only
+    // delivers events on the main thread, and waits on them so each is stamped as soon as it arrives.
+    if (headless) headlessContext.Release();
+    else glfwMakeContextCurrent(NULL);
+    pipeline.reset(new FramePipeline(pipelineDepth));
+    std::thread simulation(SimulationLoop);
+    std::thread renderer(RenderLoop, window, lightingShader.get());
+
+    if (headless) {
+        // The renderer stops by itself after the last frame
+        renderer.join();
+        pipeline->Close();
+        simulation.join();
+    }
+    else {
+        std::string title = "LearnOpenGL";
+        while (!glfwWindowShouldClose(window) && !runFinished) {
+            glfwWaitEventsTimeout(0.005);
+            std::lock_guard<std::mutex> guard(titleLock);
+            if (windowTitle != title) {
+                title = windowTitle;
+                glfwSetWindowTitle(window, title.c_str());
+            }
+        }
+        pipeline->Close();
+        simulation.join();
+        renderer.join();
+    }
+    if (!recordPath.empty())
+        recorder.Save(recordPath, simRate);
+    if (Profiler::Running() || profileExportPending) {
+        Profiler::Stop();
+        Profiler::WriteChromeTrace(profilePath);
+    }
+    if (!stress.csvPath.empty())
+        WriteStressRow(stress, stressCounts, volleySize, entities, frameTimes);
+    if (!metricsPath.empty()) {
+        RunMetrics metrics;
+        metrics.frames = frameTimes.Count();
+        metrics.hitches = frameTimes.Hitches();
+        metrics.frameMs = frameTimes.Percentile(0.5) * 1000.0;
+        metrics.frameMsP99 = frameTimes.Percentile(0.99) * 1000.0;
+        metrics.loadMs = firstFrameTime * 1000.0;
+        metrics.memoryMb = PeakMemoryMb();
+        metrics.drawCalls = renderStats.RunAverage(RENDER_DRAW_CALLS);
+        metrics.triangles = renderStats.RunAverage(RENDER_TRIANGLES);
+        if (!metrics.Write(metricsPath)) exitStatus = 1;
+    }
+    if (droppedInput > 0)
+        std::cout << "ERROR::INPUT::" << droppedInput << " events dropped, input queue full" << std::endl;
+
+    // Optional: de-allocate all resources once they've outlived their purpose:
+    // ------------------------------------------------------------------------
+    //glDeleteVertexArrays(1, luna_vao);
+    //glDeleteVertexArrays(1, &lightCubeVAO);
+    //glDeleteBuffers(1, &VBO);
+
+    // Unload the level: drop the entities, then free the whole arena at once
+    store.Clear();
+    levelArena.Reset();
+
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // ------------------------------------------------------------------
+    jobs.reset();
+    if (headless) headlessContext.Destroy();
+    else glfwTerminate();
+    return exitStatus;
+}
+
+// Simulation thread: steps the world to the present, then culls, records draws and publishes a snapshot.
+// Blocks while the render thread is 'pipelineDepth' frames behind.
+// ---------------------------------------------------------------------------------------------------------
+void SimulationLoop()
+{
+    PROFILE_THREAD("Simulation");
+    double last = fixedClock ? 0.0 : Now();
+    uint64_t frameNumber = 0;
+    for (;;) {
+        FrameSnapshot *frame;
+        {
+            PROFILE_ZONE("Wait for free slot");
+            frame = pipeline->BeginWrite();
+        }
+        if (!frame) break;
+        if (profileExportPending) {
+            Profiler::WriteChromeTrace(profilePath);
+            profileExportPending = false;
+        }
+        if (profilerToggle.exchange(false)) {
+            if (!Profiler::Running()) {
+                Profiler::Start();
+                std::cout << "Profiler: capturing, P again to stop" << std::endl;
+            }
+            else {
+                Profiler::Stop();
+                profileExportPending = true;
+            }
+        }
+        PROFILE_ZONE("Simulate frame");
+
+        // On a fixed clock a replay repeats the recorded frame times and anything else steps exactly once per
+        // frame, whatever the wall clock says
+        float frameTime = simClock.step;
+        if (replaying) player.NextFrame(frameTime);
+        double now = fixedClock ? last + frameTime : Now();
+        if (!fixedClock) frameTime = static_cast<float>(now - last);
+        last = now;
+        if (!recordPath.empty()) recorder.Frame(frameTime);
+
+        // Fixed steps, independent of the render rate. Launches fire in the step that reaches their key press;
+        // this thread helps run each step's jobs.
+        simClock.Advance(frameTime);
+        float simNow = simClock.time + simClock.accumulator;
+        if (flying) {
+            CameraKey pose = flythrough.Sample(simNow);
+            camera.SetPose(pose.position, pose.yaw, pose.pitch);
+        }
+        processInput(now, frameTime);
+        while (simClock.Step()) {
+            PROFILE_ZONE("Step");
+            FireLaunches(simClock.time);
+            jobs->Wait(ScheduleStep(simClock.time, simClock.step));
+        }
+
+        // View/Projection transformations
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        glm::vec3 eye = camera.Position;
+        glm::vec3 front = camera.Front;
+
+        // Culling and the aim preview (what the camera is looking at) run side by side
+        EntityStore::Frustum frustum(projection * view);
+        std::atomic<size_t> culledCount{ 0 };
+        JobHandle culled = jobs->ParallelFor(store.Size(), JOB_GRAIN, [&frustum, &culledCount](size_t begin, size_t end) {
+            PROFILE_ZONE("Cull");
+            SubsystemTimer timer(SUB_CULL);
+            culledCount += store.Cull(frustum, begin, end);
+        });
+        Entity target = NO_ENTITY;
+        JobHandle aimed = jobs->Schedule([&target, eye, front]() {
+            PROFILE_ZONE("Aim");
+            SubsystemTimer timer(SUB_AIM);
+            store.BuildQuery(sceneQuery);
+            RayHit aim;
+            if (sceneQuery.Closest(Ray(eye, front), aim)) target = aim.id;
+        });
+        jobs->Wait(culled);
+        jobs->Wait(aimed);
+
+        if (target != AimTarget) {
+            AimTarget = target;
+            aimTitle = "LearnOpenGL";
+            if (target != NO_ENTITY) aimTitle += std::string(" - aiming at ") + store.name[store.Row(target)];
+        }
+
+        // Draw the visible entities between the last two simulation steps: workers record draw packets while
+        // the dirty matrices are rebuilt
+        size_t rows = store.Size();
+        renderQueue.Begin((rows + JOB_GRAIN - 1) / JOB_GRAIN);
+        JobHandle recorded = jobs->ParallelFor(rows, JOB_GRAIN, [eye](size_t begin, size_t end) {
+            PROFILE_ZONE("RecordDraws");
+            SubsystemTimer timer(SUB_RECORD);
+            store.RecordDraws(renderQueue.Bucket(begin / JOB_GRAIN), begin, end, eye);
+        });
+        float alpha = simClock.Alpha();
+        JobHandle composed = jobs->Schedule([alpha]() {
+            PROFILE_ZONE("UpdateRenderTransforms");
+            SubsystemTimer timer(SUB_TRANSFORMS);
+            store.UpdateRenderTransforms(alpha);
+        });
+        JobHandle sorted = jobs->Schedule([]() {
+            PROFILE_ZONE("RenderQueue::Sort");
+            SubsystemTimer timer(SUB_SORT);
+            renderQueue.Sort();
+        }, { recorded });
+        jobs->Wait(sorted);
+        jobs->Wait(composed);
+
+        // Snapshot: the packets with their matrices copied out, so the store can move on
+        PROFILE_ZONE("Snapshot");
+        SubsystemTimer snapshotTimer(SUB_SNAPSHOT);
+        frame->frame = frameNumber++;
+        subsystemFrames++;
+        frame->inputTime = now;
+        frame->view = view;
+        frame->projection = projection;
+        frame->eye = eye;
+        frame->title = aimTitle;
+        frame->culled = culledCount;
+        frame->last = (headlessFrames > 0 && frameNumber == headlessFrames) || (replaying && player.Finished())
+                      || (flying && simNow >= flythrough.Duration());
+        frame->packets.clear();
+        frame->world.clear();
+        frame->normal.clear();
+        snapshotIndex.assign(rows, NO_ROW);
+        for (DrawPacket p : renderQueue.Packets()) {
+            uint32_t &index = snapshotIndex[p.transform];
+            if (index == NO_ROW) {
+                index = (uint32_t)frame->world.size();
+                frame->world.push_back(store.transform.world[p.transform]);
+                frame->normal.push_back(store.transform.normal[p.transform]);
+            }
+            p.transform = index;
+            frame->packets.push_back(p);
+        }
+
+        // Entities destroyed this frame give up their rows
+        store.FlushDestroyed();
+
+        bool lastFrame = frame->last;
+        pipeline->EndWrite();
+        if (lastFrame) break;
+    }
+}
+
+// Render thread: owns the GL context and draws each snapshot the simulation hands over
+// ---------------------------------------------------------------------------------------------------------
+void RenderLoop(GLFWwindow *window, Shader *shader)
+{
+    OffscreenTarget target;
+    if (headless) {
+        headlessContext.MakeCurrent();
+        if (!target.Create(SCR_WIDTH, SCR_HEIGHT)) {
+            exitStatus = -1;
+            return;
+        }
+    }
+    else glfwMakeContextCurrent(window);
+    PROFILE_THREAD("Render");
+    if (gpuTimers) gpuTimer.Init();
+    StatsOverlay overlay;
+    overlay.Init();
+    bool overlayShown = false;
+    if (!statsCsvPath.empty()) renderStats.OpenCsv(statsCsvPath);
+    Shader &lightingShader = *shader;
+    int width = 0, height = 0;
+    std::string title = "LearnOpenGL";
+    double latencySum = 0.0;
+    int latencyFrames = 0;
+    bool startupReported = false;
+    double runStart = Now(), frameEnd = 0.0;
+    for (;;) {
+        FrameSnapshot *frame;
+        {
+            PROFILE_ZONE("Wait for frame");
+            frame = pipeline->BeginRead();
+        }
+        if (!frame) break;
+        PROFILE_ZONE("Render frame");
+
+        // Make sure the viewport matches the new window dimensions
+        if (framebufferWidth != width || framebufferHeight != height) {
+            width = framebufferWidth;
+            height = framebufferHeight;
+            glViewport(0, 0, width, height);
+        }
+        if (frame->title != title) {
+            title = frame->title;
+            std::lock_guard<std::mutex> guard(titleLock);
+            windowTitle = title;
+        }
+
         // Render
+        SubsystemTimer renderTimer(SUB_RENDER);
+        renderStats.BeginFrame();
+        CountRender(RENDER_CULLED, frame->culled);
+
+        // Textures still loading: a fixed-clock run waits for all of them before its first frame, so its
+        // frames do not depend on load speed; otherwise one upload per frame, with placeholders until then
+        if (!startupReported) {
+            if (fixedClock) startup.Finish();
+            else startup.Pump(1);
+            if (startup.Done()) {
+                startup.Report();
+                startup.Stop();
+                startupReported = true;
+            }
+        }
+        GpuTimer *timer = gpuTimers ? &gpuTimer : nullptr;
+        if (timer) {
+            timer->BeginFrame(frame->frame);
+            timer->BeginPass("Clear");
+        }
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (timer) {
+            timer->EndPass();
+            timer->BeginPass("Scene");
+        }
 
         // Be sure to activate shader when setting uniforms/drawing objects
         lightingShader.use();
         lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
         lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
         lightingShader.setVec3("lightPos", lightPos);
-        lightingShader.setVec3("viewPos", camera.Position);
+        lightingShader.setVec3("viewPos", frame->eye);
 
-        // View/Projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-        
-        // Draw Objects
-        for (auto obj : vObj) {
-            obj->Update(currTime);
-            obj->Draw(lightingShader);
-        }
-
-        mball.Update(currTime);
-        mball.CollisionDetection(vObj);
-        mball.Draw(lightingShader);
-
-        if (CollidedObject != nullptr) {
-            for (auto itr = vObj.begin(); itr != vObj.end(); itr++) {
-                if (*itr == CollidedObject) {
-                    vObj.erase(itr);
-                    CollidedObject = nullptr;
-                    MoveBall = false;
-                    mball.pos = glm::vec3(0.0f, -5.0f, 15.0f);
-                    break;
-                }
-            }
+        lightingShader.setMat4("projection", frame->projection);
+        lightingShader.setMat4("view", frame->view);
+
+        RenderQueue::Replay(frame->packets, lightingShader, frame->world.data(), frame->normal.data(), timer);
+        if (timer) {
+            timer->EndPass();
+            timer->EndFrame();
+        }
+        renderStats.EndFrame(frame->frame);
+        renderTimer.Stop();
+
+        // The overlay's own calls are not counted: the next BeginFrame drops them
+        if (showStats) {
+            if (!overlayShown || frame->frame % 30 == 0) overlay.Update(renderStats);
+            overlay.Draw(width, height);
         }
+        overlayShown = showStats;
+        double inputTime = frame->inputTime;
+        bool lastFrame = frame->last;
+        uint64_t frameNumber = frame->frame;
+        pipeline->EndRead();
 
-        if (mball.pos.y < -10.0f || mball.pos.z < -15.0f || mball.pos.x < -13.0f || mball.pos.x > 13.0f) {
-            mball.pos = glm::vec3(0.0f, -5.0f, 15.0f);
-            MoveBall = false;
+        // Headless frames are waited for, so their time includes the rasterisation
+        {
+            PROFILE_ZONE(headless ? "glFinish" : "SwapBuffers");
+            if (headless) glFinish();
+            else glfwSwapBuffers(window);
         }
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Frame to frame time; the first frame pays for shader compilation and first uploads and is left out
+        double now = Now();
+        if (frameNumber > 0) frameTimes.Add(now - frameEnd);
+        else firstFrameTime = now;
+        frameEnd = now;
+        if (lastFrame) {
+            if (headless) CheckHeadlessFrame(target);
+            runFinished = true;
+            break;
+        }
+
+        if (gpuTimers && frameNumber % 300 == 299) ReportGpuTimes();
+
+        // Input to present latency, reported every few seconds. Meaningless on a fixed clock.
+        if (fixedClock) continue;
+        latencySum += now - inputTime;
+        if (++latencyFrames == 300) {
+            std::cout << "Pipeline depth " << pipelineDepth << ": input to present " << latencySum / latencyFrames * 1000.0 << " ms average" << std::endl;
+            latencySum = 0.0;
+            latencyFrames = 0;
+        }
     }
-    // Optional: de-allocate all resources once they've outlived their purpose:
-    // ------------------------------------------------------------------------
-    //glDeleteVertexArrays(1, luna_vao);
-    //glDeleteVertexArrays(1, &lightCubeVAO);
-    //glDeleteBuffers(1, &VBO);
+    if (fixedClock)
+        frameTimes.Report(replaying ? "Replay" : flying ? "Flythrough" : "Headless", Now() - runStart);
+    if (fixedClock) renderStats.Report();
+    if (gpuTimers) {
+        ReportGpuTimes();
+        gpuTimer.Release();
+    }
+    overlay.Release();
+    if (headless) {
+        target.Destroy();
+        headlessContext.Release();
+    }
+    else glfwMakeContextCurrent(NULL);
+}
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
-    return 0;
+// Render thread: the GPU times of the latest frame read back
+void ReportGpuTimes()
+{
+    std::cout << "GPU frame " << gpuTimer.ResultFrame() << ":";
+    for (const GpuPassTiming &pass : gpuTimer.Passes()) {
+        std::cout << " " << pass.name << " " << pass.ms << " ms";
+        if (gpuTimer.HasStatistics())
+            std::cout << " (" << pass.vertices << " vertices, " << pass.primitives << " primitives, " << pass.fragments << " fragments)";
+    }
+    if (gpuTimer.perDraw) std::cout << ", draws " << gpuTimer.DrawMs() << " ms";
+    if (gpuTimer.Dropped() > 0) std::cout << ", " << gpuTimer.Dropped() << " frames not ready in time";
+    std::cout << std::endl;
 }
 
-// Process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// Render thread, headless: saves and / or checks the last frame
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void CheckHeadlessFrame(const OffscreenTarget &target)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
+    Image image;
+    image.width = target.width;
+    image.height = target.height;
+    target.Read(image.rgb);
+    if (!capturePath.empty() && !WritePPM(capturePath, image))
+        exitStatus = 1;
+    if (!goldenPath.empty()) {
+        Image golden;
+        if (!ReadPPM(goldenPath, golden)) {
+            exitStatus = 1;
+            return;
+        }
+        ImageDiff diff = Compare(image, golden, goldenTolerance);
+        if (Matches(diff, goldenAllowed))
+            std::cout << "Golden image matches (" << diff.differing << " of " << diff.pixels << " pixels differ)" << std::endl;
+        else {
+            std::cout << "ERROR::GOLDEN::" << diff.differing << " of " << diff.pixels << " pixels differ by more than "
+                      << goldenTolerance << " (max " << diff.maxError << ")" << std::endl;
+            exitStatus = 1;
+        }
+    }
+}
+
+// One simulation step as a job graph: previous state -> idle / projectiles -> bounds -> collisions.
+// Returns the last job.
+// ---------------------------------------------------------------------------------------------------------
+JobHandle ScheduleStep(float time, float dt)
+{
+    JobHandle previous = jobs->Schedule([]() {
+        PROFILE_ZONE("StorePrevious");
+        store.StorePrevious();
+    });
+    JobHandle idle = jobs->ParallelFor(store.idle.row.size(), JOB_GRAIN, [dt](size_t begin, size_t end) {
+        PROFILE_ZONE("UpdateIdle");
+        SubsystemTimer timer(SUB_IDLE);
+        store.UpdateIdle(dt, begin, end);
+    }, { previous });
+    JobHandle flight = jobs->ParallelFor(store.projectiles.row.size(), JOB_GRAIN, [time, dt](size_t begin, size_t end) {
+        PROFILE_ZONE("IntegrateProjectiles");
+        SubsystemTimer timer(SUB_PROJECTILES);
+        store.IntegrateProjectiles(begin, end, time, dt);
+    }, { previous });
+    JobHandle bounds = jobs->ParallelFor(store.Size(), JOB_GRAIN, [](size_t begin, size_t end) {
+        PROFILE_ZONE("UpdateBounds");
+        SubsystemTimer timer(SUB_BOUNDS);
+        store.UpdateBounds(begin, end);
+    }, { idle, flight });
+    return jobs->Schedule([]() {
+        PROFILE_ZONE("Collisions");
+        SubsystemTimer timer(SUB_COLLISIONS);
+        BallCollisions();
+        VolleyCollisions();
+    }, { bounds });
+}
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS){
-        if (!MoveBall) {
-            initTime = static_cast<float>(glfwGetTime());
-            MoveBall = true;
-            mball.pos_ini = glm::vec3(0.0f,-5.0f,15.0f); mball.vel_ini = glm::vec3(camera.Front.x*50,camera.Front.y*50,-50);
+// Ball vs crates and static geometry, run once per simulation step
+// ---------------------------------------------------------------------------------------------------------
+void BallCollisions()
+{
+    PROFILE_FUNCTION();
+    bool hitStatic = false;
+    glm::vec3 ballPos = store.Position(ball);
+    uint32_t ballRow = store.Row(ball);
+    store.bounds.world.ForEachOverlap(store.bounds.world.Get(ballRow), [&](size_t i) {
+        if (i == ballRow) return;
+        if (store.kind[i] == KIND_CRATE) {
+            CollidedEntity = store.entity[i];
+        }
+        else if (store.kind[i] == KIND_STATIC && !store.inDistanceField[i]) {
+            if (store.IntersectSphereAt(i, ballPos, RAD_FOR_BOUNDS)) hitStatic = true;
         }
+    });
+
+    if (CollidedEntity != NO_ENTITY) {
+        store.Destroy(CollidedEntity);
+        CollidedEntity = NO_ENTITY;
+        ResetBall();
+        return;
     }
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_RELEASE){
-        
+
+    SphereContact arenaContact;
+    if (store.InFlight(ball) && arenaField.IntersectSphere(ballPos, RAD_FOR_BOUNDS, arenaContact))
+        hitStatic = true;
+
+    if (hitStatic || ballPos.y < -10.0f || ballPos.z < -15.0f || ballPos.x < -13.0f || ballPos.x > 13.0f)
+        ResetBall();
+}
+
+void ResetBall()
+{
+    store.StopProjectile(ball);
+    store.Teleport(ball, BALL_START);
+}
+
+// Fires every volley ball that is not in flight, spread around the view direction
+void LaunchVolley(const glm::vec3 &front, float time)
+{
+    std::uniform_real_distribution<float> spread(-8.0f, 8.0f);
+    glm::vec3 aim(front.x * 50, front.y * 50, -50);
+    for (Entity e : volley) {
+        if (store.InFlight(e)) continue;
+        glm::vec3 vel = aim + glm::vec3(spread(volleyRng), spread(volleyRng), spread(volleyRng));
+        store.Teleport(e, BALL_START);
+        store.Launch(e, BALL_START, vel, time);
+        store.SetVisible(e, true);
+    }
+}
+
+// Volley balls against the crates and static blocks (not each other), then the arena field and the level bounds
+void VolleyCollisions()
+{
+    PROFILE_FUNCTION();
+    if (volley.empty()) return;
+    volleyTargets.Clear();
+    volleyTargetIds.clear();
+    volleyTargetBreaks.clear();
+    for (size_t r = 0; r < store.Size(); r++) {
+        if (!store.alive[r]) continue;
+        bool crate = store.kind[r] == KIND_CRATE;
+        if (!crate && (store.kind[r] != KIND_STATIC || store.inDistanceField[r])) continue;
+        volleyTargets.Add(store.bounds.world.Get(r));
+        volleyTargetIds.push_back(store.entity[r]);
+        volleyTargetBreaks.push_back(crate);
+    }
+
+    for (Entity e : volley) {
+        if (!store.InFlight(e)) continue;
+        uint32_t r = store.Row(e);
+        glm::vec3 pos = store.PositionAt(r);
+        bool landed = false;
+        volleyTargets.ForEachOverlap(store.bounds.world.Get(r), [&](size_t i) {
+            if (!volleyTargetBreaks[i]) {
+                if (store.IntersectSphereAt(store.Row(volleyTargetIds[i]), pos, RAD_FOR_BOUNDS)) landed = true;
+                return;
+            }
+            store.Destroy(volleyTargetIds[i]);
+            volleyTargets.Set(i, EntityStore::EmptyBox());
+            landed = true;
+        });
+        SphereContact contact;
+        if (!landed && arenaField.IntersectSphere(pos, RAD_FOR_BOUNDS, contact))
+            landed = true;
+        if (landed || pos.y < -10.0f || pos.z < -15.0f || pos.x < -13.0f || pos.x > 13.0f) {
+            store.StopProjectile(e);
+            store.SetVisible(e, false);
+        }
+    }
+}
+
+// Simulation thread: applies the queued input. 'now' is the wall time the simulation clock has just been
+// advanced to; an event at wall time t happened (now - t) seconds of simulation time before the clock's end.
+// Look and movement apply at once, launches wait for the step that reaches their key press.
+// ---------------------------------------------------------------------------------------------------------
+void processInput(double now, float frameTime)
+{
+    PROFILE_FUNCTION();
+    float simNow = simClock.time + simClock.accumulator;
+    InputEvent ev;
+    while (NextInput(now, ev)) {
+        if (ev.type == INPUT_KEY) {
+            if (ev.key < 0 || ev.key > GLFW_KEY_LAST) continue;
+            keyDown[ev.key] = ev.action != GLFW_RELEASE;
+            if (ev.action == GLFW_PRESS && (ev.key == GLFW_KEY_E || ev.key == GLFW_KEY_F)) {
+                PendingLaunch launch;
+                launch.time = std::max(simClock.time, simNow - static_cast<float>(now - ev.time));
+                launch.front = camera.Front;
+                launch.volley = ev.key == GLFW_KEY_F;
+                pendingLaunches.push_back(launch);
+            }
+        }
+        else if (ev.type == INPUT_MOUSE_MOVE)
+            camera.ProcessMouseMovement(ev.x, ev.y);
+        else if (ev.type == INPUT_SCROLL)
+            camera.ProcessMouseScroll(ev.y);
     }
+
+    if (keyDown[GLFW_KEY_W])
+        camera.ProcessKeyboard(FORWARD, frameTime);
+    if (keyDown[GLFW_KEY_S])
+        camera.ProcessKeyboard(BACKWARD, frameTime);
+    if (keyDown[GLFW_KEY_A])
+        camera.ProcessKeyboard(LEFT, frameTime);
+    if (keyDown[GLFW_KEY_D])
+        camera.ProcessKeyboard(RIGHT, frameTime);
+
+    // Holding the fire buttons keeps firing as soon as balls are back; a stress scene holds F by itself
+    bool fireVolley = keyDown[GLFW_KEY_F] || (stress.crates > 0 && !volley.empty());
+    if (pendingLaunches.empty()) {
+        PendingLaunch launch;
+        launch.time = simNow;
+        launch.front = camera.Front;
+        launch.volley = fireVolley;
+        if (fireVolley || (keyDown[GLFW_KEY_E] && !store.InFlight(ball)))
+            pendingLaunches.push_back(launch);
+    }
+}
+
+// The next input event for this frame: from the recording when replaying, where live input is dropped, from
+// the queue otherwise. Recorded as it is consumed.
+bool NextInput(double now, InputEvent &ev)
+{
+    if (replaying) {
+        while (inputQueue.Pop(ev)) {}
+        if (!player.NextEvent(now, ev)) return false;
+    }
+    else if (!inputQueue.Pop(ev)) return false;
+    if (!recordPath.empty()) recorder.Event(ev, now);
+    return true;
+}
+
+// Fires the pending launches whose key press lies at or before 'until', the time of the step about to run
+void FireLaunches(float until)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingLaunches.size(); i++) {
+        const PendingLaunch &launch = pendingLaunches[i];
+        if (launch.time > until) {
+            pendingLaunches[kept++] = launch;
+            continue;
+        }
+        if (launch.volley)
+            LaunchVolley(launch.front, launch.time);
+        else if (!store.InFlight(ball)) {
+            initTime = launch.time;
+            store.Launch(ball, BALL_START, glm::vec3(launch.front.x*50, launch.front.y*50, -50), initTime);
+        }
+    }
+    pendingLaunches.resize(kept);
+}
+
+// Seconds on a monotonic clock. Used instead of glfwGetTime() so headless runs need no GLFW.
+double Now()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PushInput(uint8_t type, int key, int action, float x, float y)
+{
+    InputEvent ev;
+    ev.time = Now();
+    ev.type = type;
+    ev.key = key;
+    ev.action = action;
+    ev.x = x;
+    ev.y = y;
+    if (!inputQueue.Push(ev)) droppedInput++;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    // Make sure the viewport matches the new window dimensions; note that width and
+    // The render thread picks the new size up before its next frame; note that width and
     // Height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
+// glfw: whenever a key is pressed or released, this callback is called
+// --------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+    if (key == GLFW_KEY_P && action == GLFW_PRESS && Profiler::Available)
+        profilerToggle = true;
+    if (key == GLFW_KEY_O && action == GLFW_PRESS)
+        showStats = !showStats;
+    if (action != GLFW_REPEAT)
+        PushInput(INPUT_KEY, key, action, 0.0f, 0.0f);
+}
 
 // glfw: whenever the mouse moves, this callback is called
 // -------------------------------------------------------
@@ -303,12 +1081,12 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     lastX = xpos;
     lastY = ypos;
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    PushInput(INPUT_MOUSE_MOVE, 0, 0, xoffset, yoffset);
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+    PushInput(INPUT_SCROLL, 0, 0, static_cast<float>(xoffset), static_cast<float>(yoffset));
 };
\ No newline at end of file
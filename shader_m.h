@@ -9,6 +9,8 @@
 #include <sstream>
 #include <iostream>
 
+#include "RenderStats.h"
+
 class Shader
 {
 public:
@@ -100,64 +102,77 @@ public:
     // ------------------------------------------------------------------------
     void use()
     {
+        CountRender(RENDER_PROGRAM_BINDS);
         glUseProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
+        CountRender(RENDER_UNIFORM_UPLOADS);
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
 